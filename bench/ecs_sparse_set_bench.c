@@ -0,0 +1,190 @@
+// microbenchmark for the sparse set component pools.
+// a "status effect" component is added to and removed from random entities
+// over and over, then every entity holding it (and a "light" component for
+// the join) is visited. this is compared with the per slot layout the old
+// object_pool_t used (one array per component covering every slot, with an
+// enabled flag) and with moving entities between archetypes.
+//
+// build and run with: make bench_ecs_sparse_set
+
+#include "lite_engine.h"
+
+#include <stdio.h>
+#include <time.h>
+
+#define BENCH_ENTITIES 100000
+#define BENCH_CHURN    1000000
+#define BENCH_ITERATE  100
+
+typedef struct {
+	float time_left;
+	float strength;
+	ui32  type;
+} status_effect_t;
+
+typedef struct {
+	float radius;
+	float intensity;
+} temporary_light_t;
+
+// the old object_pool_t layout, one entry per slot whether it is used or not
+typedef struct {
+	ui8               *effects_enabled;
+	status_effect_t   *effects;
+	ui8               *lights_enabled;
+	temporary_light_t *lights;
+} slot_pool_t;
+
+static double bench_time(void) {
+	struct timespec spec;
+	clock_gettime(CLOCK_MONOTONIC, &spec);
+	return spec.tv_sec + spec.tv_nsec * 1e-9;
+}
+
+static void bench_report(const char *name, double seconds, size_t operations) {
+	printf("  %-34s %8.3f ms %8.2f ns/op\n", name, seconds * 1e3, seconds * 1e9 / operations);
+}
+
+int main(void) {
+	srand(42);
+
+	ui64 *entities = malloc(sizeof(*entities) * BENCH_ENTITIES);
+	ui32 *picks    = malloc(sizeof(*picks)    * BENCH_CHURN);
+	for (ui32 i = 0; i < BENCH_ENTITIES; i++) {
+		entities[i] = lite_engine_entity_create();
+	}
+	for (ui32 i = 0; i < BENCH_CHURN; i++) {
+		picks[i] = rand() % BENCH_ENTITIES;
+	}
+
+	volatile float sink = 0;
+
+	printf("%d entities, %d add/remove, %d iterations\n", BENCH_ENTITIES, BENCH_CHURN, BENCH_ITERATE);
+
+	{ // old per slot layout
+		slot_pool_t pool = {
+			.effects_enabled = calloc(BENCH_ENTITIES, sizeof(*pool.effects_enabled)),
+			.effects         = calloc(BENCH_ENTITIES, sizeof(*pool.effects)),
+			.lights_enabled  = calloc(BENCH_ENTITIES, sizeof(*pool.lights_enabled)),
+			.lights          = calloc(BENCH_ENTITIES, sizeof(*pool.lights)),
+		};
+		for (ui32 i = 0; i < BENCH_ENTITIES; i += 4) {
+			pool.lights_enabled[i] = 1;
+			pool.lights[i]         = (temporary_light_t) { 1, 1 };
+		}
+
+		printf("per slot arrays (object_pool_t)\n");
+
+		double start = bench_time();
+		for (ui32 i = 0; i < BENCH_CHURN; i++) {
+			ui32 slot = picks[i];
+			if (pool.effects_enabled[slot]) {
+				pool.effects_enabled[slot] = 0;
+			} else {
+				pool.effects_enabled[slot] = 1;
+				pool.effects[slot] = (status_effect_t) { 1, 1, i };
+			}
+		}
+		bench_report("add/remove", bench_time() - start, BENCH_CHURN);
+
+		start = bench_time();
+		for (ui32 it = 0; it < BENCH_ITERATE; it++) {
+			for (ui32 slot = 0; slot < BENCH_ENTITIES; slot++) {
+				if (pool.effects_enabled[slot]) {
+					pool.effects[slot].time_left -= 0.016f;
+				}
+			}
+		}
+		bench_report("iterate effects", bench_time() - start, BENCH_ITERATE);
+
+		start = bench_time();
+		for (ui32 it = 0; it < BENCH_ITERATE; it++) {
+			for (ui32 slot = 0; slot < BENCH_ENTITIES; slot++) {
+				if (pool.effects_enabled[slot] && pool.lights_enabled[slot]) {
+					sink += pool.effects[slot].strength * pool.lights[slot].intensity;
+				}
+			}
+		}
+		bench_report("join effects+lights", bench_time() - start, BENCH_ITERATE);
+
+		free(pool.effects_enabled);
+		free(pool.effects);
+		free(pool.lights_enabled);
+		free(pool.lights);
+	}
+
+	{ // sparse sets
+		lite_engine_sparse_set_t *effects = lite_engine_sparse_set_create(sizeof(status_effect_t));
+		lite_engine_sparse_set_t *lights  = lite_engine_sparse_set_create(sizeof(temporary_light_t));
+		for (ui32 i = 0; i < BENCH_ENTITIES; i += 4) {
+			lite_engine_sparse_set_add(lights, entities[i], &(temporary_light_t) { 1, 1 });
+		}
+
+		printf("sparse sets\n");
+
+		double start = bench_time();
+		for (ui32 i = 0; i < BENCH_CHURN; i++) {
+			ui64 entity = entities[picks[i]];
+			if (lite_engine_sparse_set_has(effects, entity)) {
+				lite_engine_sparse_set_remove(effects, entity);
+			} else {
+				lite_engine_sparse_set_add(effects, entity, &(status_effect_t) { 1, 1, i });
+			}
+		}
+		bench_report("add/remove", bench_time() - start, BENCH_CHURN);
+
+		start = bench_time();
+		for (ui32 it = 0; it < BENCH_ITERATE; it++) {
+			status_effect_t *e = (status_effect_t *)effects->components;
+			for (ui32 i = 0; i < effects->count; i++) {
+				e[i].time_left -= 0.016f;
+			}
+		}
+		bench_report("iterate effects", bench_time() - start, BENCH_ITERATE);
+
+		start = bench_time();
+		for (ui32 it = 0; it < BENCH_ITERATE; it++) {
+			lite_engine_sparse_set_t     *sets[] = { effects, lights };
+			lite_engine_sparse_set_join_t join   = lite_engine_sparse_set_join(sets, 2);
+			while (lite_engine_sparse_set_join_next(&join)) {
+				status_effect_t   *effect = join.components[0];
+				temporary_light_t *light  = join.components[1];
+				sink += effect->strength * light->intensity;
+			}
+		}
+		bench_report("join effects+lights", bench_time() - start, BENCH_ITERATE);
+		printf("  (%u effects, %u lights)\n", effects->count, lights->count);
+
+		lite_engine_sparse_set_free(effects);
+		lite_engine_sparse_set_free(lights);
+	}
+
+	{ // archetypes, for the add/remove cost only
+		lite_engine_component_t position = lite_engine_component_register(sizeof(float) * 3);
+		lite_engine_component_t effect   = lite_engine_component_register(sizeof(status_effect_t));
+		for (ui32 i = 0; i < BENCH_ENTITIES; i++) {
+			lite_engine_entity_add_component(entities[i], position, NULL);
+		}
+
+		printf("archetype moves\n");
+
+		double start = bench_time();
+		for (ui32 i = 0; i < BENCH_CHURN; i++) {
+			ui64 entity = entities[picks[i]];
+			if (lite_engine_entity_has_component(entity, effect)) {
+				lite_engine_entity_remove_component(entity, effect);
+			} else {
+				lite_engine_entity_add_component(entity, effect, &(status_effect_t) { 1, 1, i });
+			}
+		}
+		bench_report("add/remove", bench_time() - start, BENCH_CHURN);
+	}
+
+	(void)sink;
+
+	lite_engine_entity_free_all();
+	free(entities);
+	free(picks);
+
+	return 0;
+}
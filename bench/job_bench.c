@@ -0,0 +1,136 @@
+// microbenchmark for the work stealing job system.
+// for 1 to N threads (the calling thread plus N - 1 workers) it measures:
+//   - the cost of submitting and waiting on many empty jobs
+//   - the cost of a parallel_for over a tiny range, i.e. its fixed overhead
+//   - a fork/join tree where every job spawns two more and waits on them
+//   - the speedup of a compute bound parallel_for with automatic batching
+// N defaults to the core count and can be given as the first argument.
+//
+// build and run with: make bench_job
+
+#include "lite_engine.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BENCH_EMPTY_JOBS     200000
+#define BENCH_SMALL_FORS     20000
+#define BENCH_TREE_DEPTH     16
+#define BENCH_WORK_ITEMS     (1 << 20)
+#define BENCH_WORK_PER_ITEM  64
+#define BENCH_REPEAT         5
+
+static double bench_time(void) {
+	struct timespec spec;
+	clock_gettime(CLOCK_MONOTONIC, &spec);
+	return spec.tv_sec + spec.tv_nsec * 1e-9;
+}
+
+static void bench_empty(void *data) {
+	(void)data;
+}
+
+static void bench_empty_range(void *data, ui32 begin, ui32 end) {
+	(void)data;
+	(void)begin;
+	(void)end;
+}
+
+typedef struct {
+	ui32 depth;
+} tree_node_t;
+
+static void bench_tree(void *data) {
+	tree_node_t *node = data;
+	if (node->depth == 0) {
+		return;
+	}
+
+	tree_node_t               children[2] = { { node->depth - 1 }, { node->depth - 1 } };
+	lite_engine_job_counter_t counter     = {0};
+	lite_engine_job_submit_counted(bench_tree, &children[0], &counter);
+	lite_engine_job_submit_counted(bench_tree, &children[1], &counter);
+	lite_engine_job_wait(&counter);
+}
+
+static void bench_work(void *data, ui32 begin, ui32 end) {
+	float *out = data;
+	for (ui32 i = begin; i < end; i++) {
+		float x = (float)i;
+		for (ui32 k = 0; k < BENCH_WORK_PER_ITEM; k++) {
+			x = sqrtf(x * 1.0001f + 1.0f);
+		}
+		out[i] = x;
+	}
+}
+
+int main(int argc, char **argv) {
+	long cores       = sysconf(_SC_NPROCESSORS_ONLN);
+	ui32 max_threads = argc > 1 ? (ui32)atoi(argv[1]) : (ui32)(cores > 0 ? cores : 1);
+	if (max_threads == 0) {
+		max_threads = 1;
+	}
+
+	float *out = malloc(sizeof(*out) * BENCH_WORK_ITEMS);
+
+	printf("%ld cores, measuring 1 to %u threads\n", cores, max_threads);
+	printf("  %-8s %14s %14s %14s %12s %9s\n",
+			"threads", "empty job", "small for", "tree job", "work", "speedup");
+
+	double single_thread_work = 0;
+	for (ui32 threads = 1; threads <= max_threads; threads++) {
+		lite_engine_job_start(threads - 1);
+
+		double best_empty = 1e9, best_small = 1e9, best_tree = 1e9, best_work = 1e9;
+		for (ui32 r = 0; r < BENCH_REPEAT; r++) {
+			double start = bench_time();
+			lite_engine_job_counter_t counter = {0};
+			for (ui32 i = 0; i < BENCH_EMPTY_JOBS; i++) {
+				lite_engine_job_submit_counted(bench_empty, NULL, &counter);
+			}
+			lite_engine_job_wait(&counter);
+			double empty = bench_time() - start;
+			best_empty   = empty < best_empty ? empty : best_empty;
+
+			start = bench_time();
+			for (ui32 i = 0; i < BENCH_SMALL_FORS; i++) {
+				lite_engine_job_parallel_for(threads * 4, 1, bench_empty_range, NULL);
+			}
+			double small = bench_time() - start;
+			best_small   = small < best_small ? small : best_small;
+
+			start = bench_time();
+			tree_node_t root = { BENCH_TREE_DEPTH };
+			bench_tree(&root);
+			double tree = bench_time() - start;
+			best_tree   = tree < best_tree ? tree : best_tree;
+
+			start = bench_time();
+			lite_engine_job_parallel_for(BENCH_WORK_ITEMS, 0, bench_work, out);
+			double work = bench_time() - start;
+			best_work   = work < best_work ? work : best_work;
+		}
+
+		if (threads == 1) {
+			single_thread_work = best_work;
+		}
+
+		ui32 tree_jobs = (1u << (BENCH_TREE_DEPTH + 1)) - 2;
+		printf("  %-8u %11.1f ns %11.1f ns %11.1f ns %9.2f ms %8.2fx\n", threads,
+				best_empty * 1e9 / BENCH_EMPTY_JOBS,
+				best_small * 1e9 / BENCH_SMALL_FORS,
+				best_tree  * 1e9 / tree_jobs,
+				best_work  * 1e3,
+				single_thread_work / best_work);
+
+		lite_engine_job_stop();
+	}
+
+	volatile float sink = out[BENCH_WORK_ITEMS / 2];
+	(void)sink;
+	free(out);
+
+	return 0;
+}
@@ -0,0 +1,221 @@
+// microbenchmark for lite_engine_gl_mesh_lmod_read. generates a text .lmod
+// with positions, normals, texture coordinates and indices in the layout
+// the exporter writes, then parses it with the old sscanf loop and with the
+// current reader. the old loop rescans the rest of the text on every
+// sscanf call, so it only runs on the small file.
+// the vertex count of the large file can be given as the first argument.
+//
+// build and run with: make bench_lmod
+
+#include "lite_engine_gl.h"
+
+#include <ctype.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+DEFINE_LIST(vertex_t)
+DEFINE_LIST(GLuint)
+DEFINE_LIST(submesh_t)
+DEFINE_LIST(vector3_t)
+DEFINE_LIST(vector2_t)
+
+#define BENCH_SMALL_VERTICES 20000
+#define BENCH_LARGE_VERTICES 4000000
+#define BENCH_REPEAT         3
+
+static double bench_time(void) {
+	struct timespec spec;
+	clock_gettime(CLOCK_MONOTONIC, &spec);
+	return spec.tv_sec + spec.tv_nsec * 1e-9;
+}
+
+static float bench_random(float min, float max) {
+	return min + (max - min) * ((float)rand() / (float)RAND_MAX);
+}
+
+// a text .lmod of 'vertex_count' vertices, one triangle per three
+static char *bench_generate(ui32 vertex_count, size_t *length) {
+	size_t capacity = (size_t)vertex_count * 96 + 256;
+	char  *text     = malloc(capacity);
+	char  *c        = text;
+
+	c += sprintf(c, "# LMOD file\nmesh: bench\nvertex_positions:\n");
+	for (ui32 i = 0; i < vertex_count; i++) {
+		c += sprintf(c, "%.4f\t%.4f\t%.4f\n",
+				bench_random(-100, 100), bench_random(-100, 100), bench_random(-100, 100));
+	}
+	c += sprintf(c, "vertex_normals:\n");
+	for (ui32 i = 0; i < vertex_count; i++) {
+		c += sprintf(c, "%.4f\t%.4f\t%.4f\n", bench_random(-1, 1), bench_random(-1, 1), bench_random(-1, 1));
+	}
+	c += sprintf(c, "vertex_texture_coordinates:\n");
+	for (ui32 i = 0; i < vertex_count; i++) {
+		c += sprintf(c, "%.4f %.4f\n", bench_random(0, 1), bench_random(0, 1));
+	}
+	c += sprintf(c, "vertex_indices:\n");
+	for (ui32 i = 0; i < vertex_count - vertex_count % 3; i++) {
+		c += sprintf(c, "%u ", i);
+	}
+	c += sprintf(c, "\n");
+
+	*length = c - text;
+	return text;
+}
+
+// the loop lite_engine_gl_mesh_lmod_alloc used before the reader, minus the
+// error handling
+static void bench_reference(char *text, size_t length, list_vertex_t *vertices, list_GLuint *indices) {
+	list_vector3_t positions  = list_vector3_t_alloc();
+	list_vector3_t normals    = list_vector3_t_alloc();
+	list_vector2_t tex_coords = list_vector2_t_alloc();
+
+	enum { STATE_INITIAL, STATE_POSITION, STATE_INDICES, STATE_NORMAL, STATE_TEX_COORD };
+	ui8 state = STATE_INITIAL;
+
+	for (char *c = text; c < text + length; c++) {
+		if (isspace(*c)) {
+			continue;
+		} else if (*c == '#') {
+			while (*c != '\n' && *c != '\0') { c++; }
+			continue;
+		}
+
+		char token[128];
+		sscanf(c, "%s", token);
+
+		if (strcmp(token, "vertex_indices:") == 0 || state == STATE_INDICES) {
+			if (state != STATE_INDICES)
+				c += sizeof("vertex_indices:");
+			state = STATE_INDICES;
+			GLuint index;
+			sscanf(c, "%u", &index);
+			while (*c != ' ' && *c != '\0') { c++; }
+			list_GLuint_add(indices, index);
+		}
+		if (strcmp(token, "vertex_texture_coordinates:") == 0 || state == STATE_TEX_COORD) {
+			if (state != STATE_TEX_COORD)
+				c += sizeof("vertex_texture_coordinates:");
+			state = STATE_TEX_COORD;
+			vector2_t tex_coord = {0};
+			sscanf(c, "%f %f", &tex_coord.x, &tex_coord.y);
+			list_vector2_t_add(&tex_coords, tex_coord);
+			while (*c != '\n' && *c != '\0') { c++; }
+		}
+		if (strcmp(token, "vertex_normals:") == 0 || state == STATE_NORMAL) {
+			if (state != STATE_NORMAL)
+				c += sizeof("vertex_normals:");
+			state = STATE_NORMAL;
+			vector3_t normal = {0};
+			sscanf(c, "%f %f %f", &normal.x, &normal.y, &normal.z);
+			list_vector3_t_add(&normals, normal);
+			while (*c != '\n' && *c != '\0') { c++; }
+		}
+		if (strcmp(token, "vertex_positions:") == 0 || state == STATE_POSITION) {
+			if (state != STATE_POSITION)
+				c += sizeof("vertex_positions:");
+			state = STATE_POSITION;
+			vector3_t position = {0};
+			sscanf(c, "%f %f %f", &position.x, &position.y, &position.z);
+			list_vector3_t_add(&positions, position);
+			while (*c != '\n' && *c != '\0') { c++; }
+		}
+	}
+
+	for (size_t i = 0; i < positions.length; i++) {
+		vertex_t vertex = { .position = positions.array[i] };
+		if (normals.length > 0)
+		vertex.normal   = normals.array[i];
+		if (tex_coords.length > 0)
+		vertex.texCoord = tex_coords.array[i];
+		list_vertex_t_add(vertices, vertex);
+	}
+
+	list_vector3_t_free(&positions);
+	list_vector3_t_free(&normals);
+	list_vector2_t_free(&tex_coords);
+}
+
+static float bench_max_error(const list_vertex_t *a, const list_vertex_t *b) {
+	float error = 0;
+	for (size_t i = 0; i < a->length && i < b->length; i++) {
+		const float *x = (const float *)&a->array[i];
+		const float *y = (const float *)&b->array[i];
+		for (size_t k = 0; k < sizeof(vertex_t) / sizeof(float); k++) {
+			error = fmaxf(error, fabsf(x[k] - y[k]));
+		}
+	}
+	return error;
+}
+
+static double bench_read(const char *text, size_t length, list_vertex_t *vertices, list_GLuint *indices) {
+	list_submesh_t submeshes = list_submesh_t_alloc();
+	double         best      = 1e9;
+	for (ui32 r = 0; r < BENCH_REPEAT; r++) {
+		double start = bench_time();
+		if (!lite_engine_gl_mesh_lmod_read(text, length, "bench", vertices, indices, &submeshes)) {
+			best = -1;
+			break;
+		}
+		double time = bench_time() - start;
+		best = time < best ? time : best;
+	}
+	list_submesh_t_free(&submeshes);
+	return best;
+}
+
+int main(int argc, char **argv) {
+	ui32 large = argc > 1 ? (ui32)atoi(argv[1]) : BENCH_LARGE_VERTICES;
+
+	srand(42);
+
+	{ // both parsers on the small file
+		size_t length;
+		char  *text = bench_generate(BENCH_SMALL_VERTICES, &length);
+
+		list_vertex_t reference_vertices = list_vertex_t_alloc();
+		list_GLuint   reference_indices  = list_GLuint_alloc();
+		double start     = bench_time();
+		bench_reference(text, length, &reference_vertices, &reference_indices);
+		double reference = bench_time() - start;
+
+		list_vertex_t vertices = list_vertex_t_alloc();
+		list_GLuint   indices  = list_GLuint_alloc();
+		double        reader   = bench_read(text, length, &vertices, &indices);
+
+		printf("%u vertices, %.2f MB of text\n", BENCH_SMALL_VERTICES, length / 1e6);
+		printf("\tsscanf loop %10.2f ms %8.2f MB/s\n", reference * 1e3, length / reference / 1e6);
+		printf("\treader      %10.2f ms %8.2f MB/s %8.1fx  max error %g, indices %s\n",
+				reader * 1e3, length / reader / 1e6, reference / reader,
+				bench_max_error(&vertices, &reference_vertices),
+				indices.length == reference_indices.length &&
+				memcmp(indices.array, reference_indices.array, sizeof(GLuint) * indices.length) == 0 ?
+				"match" : "DIFFER");
+
+		list_vertex_t_free(&reference_vertices);
+		list_GLuint_free(&reference_indices);
+		list_vertex_t_free(&vertices);
+		list_GLuint_free(&indices);
+		free(text);
+	}
+
+	{ // the reader alone on the large file
+		size_t length;
+		char  *text = bench_generate(large, &length);
+
+		list_vertex_t vertices = list_vertex_t_alloc();
+		list_GLuint   indices  = list_GLuint_alloc();
+		double        reader   = bench_read(text, length, &vertices, &indices);
+
+		printf("%u vertices, %.2f MB of text\n", large, length / 1e6);
+		printf("\treader      %10.2f ms %8.2f MB/s  %zu vertices %zu indices\n",
+				reader * 1e3, length / reader / 1e6, vertices.length, indices.length);
+
+		list_vertex_t_free(&vertices);
+		list_GLuint_free(&indices);
+		free(text);
+	}
+
+	return 0;
+}
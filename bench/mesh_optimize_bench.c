@@ -0,0 +1,222 @@
+// microbenchmark for lite_engine_gl_mesh_optimize. builds a grid and a
+// sphere, shuffles their triangles the way an exporter might hand them
+// over, optimizes them and prints the vertex cache figures before and
+// after. also checks that the result is the same on every run and still
+// draws the same triangles.
+// the grid size can be given as the first argument.
+//
+// build and run with: make bench_mesh_optimize
+
+#include "lite_engine_gl.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+DEFINE_LIST(vertex_t)
+DEFINE_LIST(GLuint)
+DEFINE_LIST(submesh_t)
+
+#define BENCH_GRID_SIZE     256
+#define BENCH_SPHERE_RINGS  128
+#define BENCH_SPHERE_SLICES 256
+
+static double bench_time(void) {
+	struct timespec spec;
+	clock_gettime(CLOCK_MONOTONIC, &spec);
+	return spec.tv_sec + spec.tv_nsec * 1e-9;
+}
+
+// xorshift, so the shuffle is the same everywhere
+static ui32 bench_random(ui32 *state) {
+	*state ^= *state << 13;
+	*state ^= *state >> 17;
+	*state ^= *state << 5;
+	return *state;
+}
+
+static void bench_add_quad(list_GLuint *indices, GLuint a, GLuint b, GLuint c, GLuint d) {
+	list_GLuint_add(indices, a);
+	list_GLuint_add(indices, b);
+	list_GLuint_add(indices, c);
+	list_GLuint_add(indices, c);
+	list_GLuint_add(indices, b);
+	list_GLuint_add(indices, d);
+}
+
+static void bench_grid(ui32 size, list_vertex_t *vertices, list_GLuint *indices) {
+	for (ui32 y = 0; y <= size; y++) {
+		for (ui32 x = 0; x <= size; x++) {
+			vertex_t vertex = {
+				.position = { x, 0, y },
+				.texCoord = { (float)x / size, (float)y / size },
+				.normal   = { 0, 1, 0 },
+			};
+			list_vertex_t_add(vertices, vertex);
+		}
+	}
+	for (ui32 y = 0; y < size; y++) {
+		for (ui32 x = 0; x < size; x++) {
+			GLuint i = y * (size + 1) + x;
+			bench_add_quad(indices, i, i + size + 1, i + 1, i + size + 2);
+		}
+	}
+}
+
+static void bench_sphere(ui32 rings, ui32 slices, list_vertex_t *vertices, list_GLuint *indices) {
+	for (ui32 r = 0; r <= rings; r++) {
+		float pitch = (float)M_PI * r / rings;
+		for (ui32 s = 0; s <= slices; s++) {
+			float     yaw    = 2.0f * (float)M_PI * s / slices;
+			vector3_t normal = { sinf(pitch) * cosf(yaw), cosf(pitch), sinf(pitch) * sinf(yaw) };
+			vertex_t  vertex = {
+				.position = normal,
+				.texCoord = { (float)s / slices, (float)r / rings },
+				.normal   = normal,
+			};
+			list_vertex_t_add(vertices, vertex);
+		}
+	}
+	for (ui32 r = 0; r < rings; r++) {
+		for (ui32 s = 0; s < slices; s++) {
+			GLuint i = r * (slices + 1) + s;
+			bench_add_quad(indices, i, i + 1, i + slices + 1, i + slices + 2);
+		}
+	}
+}
+
+static void bench_shuffle(list_GLuint *indices) {
+	ui32 state         = 42;
+	ui32 triangle_count = indices->length / 3;
+	for (ui32 t = triangle_count - 1; t > 0; t--) {
+		ui32   other = bench_random(&state) % (t + 1);
+		GLuint swap[3];
+		memcpy(swap, &indices->array[t * 3], sizeof(swap));
+		memcpy(&indices->array[t * 3], &indices->array[other * 3], sizeof(swap));
+		memcpy(&indices->array[other * 3], swap, sizeof(swap));
+	}
+}
+
+// triangles as vertex positions, rotated so the corner with the lowest
+// position comes first, which keeps the winding
+typedef struct {
+	vector3_t corners[3];
+} bench_triangle_t;
+
+static int bench_compare_position(const vector3_t *a, const vector3_t *b) {
+	return memcmp(a, b, sizeof(*a));
+}
+
+static int bench_compare_triangle(const void *a, const void *b) {
+	return memcmp(a, b, sizeof(bench_triangle_t));
+}
+
+static bench_triangle_t *bench_triangles(const list_vertex_t *vertices, const list_GLuint *indices) {
+	ui32              count     = indices->length / 3;
+	bench_triangle_t *triangles = malloc(sizeof(*triangles) * count);
+	for (ui32 t = 0; t < count; t++) {
+		ui32 first = 0;
+		for (ui32 k = 1; k < 3; k++) {
+			if (bench_compare_position(&vertices->array[indices->array[t * 3 + k]].position,
+						&vertices->array[indices->array[t * 3 + first]].position) < 0) {
+				first = k;
+			}
+		}
+		for (ui32 k = 0; k < 3; k++) {
+			triangles[t].corners[k] = vertices->array[indices->array[t * 3 + (first + k) % 3]].position;
+		}
+	}
+	qsort(triangles, count, sizeof(*triangles), bench_compare_triangle);
+	return triangles;
+}
+
+static void bench_run(const char *name, const list_vertex_t *source_vertices,
+		const list_GLuint *source_indices, ui32 flags) {
+	list_vertex_t  vertices  = list_vertex_t_alloc();
+	list_GLuint    indices   = list_GLuint_alloc();
+	list_submesh_t submeshes = list_submesh_t_alloc();
+	for (size_t i = 0; i < source_vertices->length; i++) {
+		list_vertex_t_add(&vertices, source_vertices->array[i]);
+	}
+	for (size_t i = 0; i < source_indices->length; i++) {
+		list_GLuint_add(&indices, source_indices->array[i]);
+	}
+
+	lite_engine_gl_mesh_cache_stats_t before = lite_engine_gl_mesh_analyze_vertex_cache(
+			&indices, &submeshes, vertices.length, LITE_ENGINE_GL_MESH_VERTEX_CACHE_SIZE);
+
+	double start = bench_time();
+	lite_engine_gl_mesh_optimize(&vertices, &indices, &submeshes, flags);
+	double time = bench_time() - start;
+
+	lite_engine_gl_mesh_cache_stats_t after = lite_engine_gl_mesh_analyze_vertex_cache(
+			&indices, &submeshes, vertices.length, LITE_ENGINE_GL_MESH_VERTEX_CACHE_SIZE);
+
+	// a second run from the same input has to give the same buffers
+	list_vertex_t again_vertices = list_vertex_t_alloc();
+	list_GLuint   again_indices  = list_GLuint_alloc();
+	for (size_t i = 0; i < source_vertices->length; i++) {
+		list_vertex_t_add(&again_vertices, source_vertices->array[i]);
+	}
+	for (size_t i = 0; i < source_indices->length; i++) {
+		list_GLuint_add(&again_indices, source_indices->array[i]);
+	}
+	lite_engine_gl_mesh_optimize(&again_vertices, &again_indices, &submeshes, flags);
+	ui8 deterministic =
+		memcmp(vertices.array, again_vertices.array, sizeof(vertex_t) * vertices.length) == 0 &&
+		memcmp(indices.array,  again_indices.array,  sizeof(GLuint)   * indices.length)  == 0;
+
+	bench_triangle_t *expected = bench_triangles(source_vertices, source_indices);
+	bench_triangle_t *actual   = bench_triangles(&vertices, &indices);
+	ui8 same = memcmp(expected, actual, sizeof(*expected) * (indices.length / 3)) == 0;
+
+	printf("\t%-24s %8.2f ms  ACMR %.3f -> %.3f  ATVR %.3f -> %.3f  %s, %s\n",
+			name, time * 1e3, before.acmr, after.acmr, before.atvr, after.atvr,
+			deterministic ? "deterministic" : "NOT DETERMINISTIC",
+			same ? "same triangles" : "TRIANGLES DIFFER");
+
+	free(expected);
+	free(actual);
+	list_vertex_t_free(&vertices);
+	list_GLuint_free(&indices);
+	list_vertex_t_free(&again_vertices);
+	list_GLuint_free(&again_indices);
+	list_submesh_t_free(&submeshes);
+}
+
+static void bench_mesh(const char *name, list_vertex_t *vertices, list_GLuint *indices) {
+	bench_shuffle(indices);
+	printf("%s, %zu vertices, %zu triangles, FIFO cache of %u\n",
+			name, vertices->length, indices->length / 3, LITE_ENGINE_GL_MESH_VERTEX_CACHE_SIZE);
+	bench_run("vertex cache", vertices, indices,
+			LITE_ENGINE_GL_MESH_OPTIMIZE_VERTEX_CACHE);
+	bench_run("vertex cache, overdraw", vertices, indices,
+			LITE_ENGINE_GL_MESH_OPTIMIZE_VERTEX_CACHE | LITE_ENGINE_GL_MESH_OPTIMIZE_OVERDRAW);
+	bench_run("all", vertices, indices,
+			LITE_ENGINE_GL_MESH_OPTIMIZE_ALL);
+}
+
+int main(int argc, char **argv) {
+	ui32 size = argc > 1 ? (ui32)atoi(argv[1]) : BENCH_GRID_SIZE;
+
+	{
+		list_vertex_t vertices = list_vertex_t_alloc();
+		list_GLuint   indices  = list_GLuint_alloc();
+		bench_grid(size, &vertices, &indices);
+		bench_mesh("grid", &vertices, &indices);
+		list_vertex_t_free(&vertices);
+		list_GLuint_free(&indices);
+	}
+
+	{
+		list_vertex_t vertices = list_vertex_t_alloc();
+		list_GLuint   indices  = list_GLuint_alloc();
+		bench_sphere(BENCH_SPHERE_RINGS, BENCH_SPHERE_SLICES, &vertices, &indices);
+		bench_mesh("sphere", &vertices, &indices);
+		list_vertex_t_free(&vertices);
+		list_GLuint_free(&indices);
+	}
+
+	return 0;
+}
@@ -0,0 +1,113 @@
+// microbenchmark for lite_engine_gl_transform_batch_calculate_matrices.
+// compares the old per transform path (three matrices, two multiplies)
+// with every batch kernel the cpu supports at 1k, 10k and 100k transforms.
+//
+// build and run with: make bench_transform
+
+#include "lite_engine_gl.h"
+
+#define BLIB_IMPLEMENTATION
+#include "blib/blib_math3d.h"
+
+#include <time.h>
+
+static double bench_time(void) {
+	struct timespec spec;
+	clock_gettime(CLOCK_MONOTONIC, &spec);
+	return spec.tv_sec + spec.tv_nsec * 1e-9;
+}
+
+static float bench_random(float min, float max) {
+	return min + (max - min) * ((float)rand() / (float)RAND_MAX);
+}
+
+// what lite_engine_gl_transform_calculate_matrix did before matrices were
+// composed straight from TRS
+static void bench_reference(transform_t *transforms, size_t count) {
+	for (size_t i = 0; i < count; i++) {
+		transform_t *t = &transforms[i];
+		matrix4_t translation = matrix4_translate(t->position);
+		matrix4_t rotation = quaternion_to_matrix4(t->rotation);
+		matrix4_t scale = matrix4_scale(t->scale);
+		t->matrix = matrix4_multiply(rotation, translation);
+		t->matrix = matrix4_multiply(scale, t->matrix);
+	}
+}
+
+int main(void) {
+	const size_t counts[] = { 1000, 10000, 100000 };
+	const char  *kernels[] = { "scalar", "sse", NULL };
+
+	srand(42);
+
+	for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+		size_t count      = counts[c];
+		size_t iterations = 10000000 / count;
+
+		transform_t *transforms = calloc(sizeof(*transforms), count);
+		matrix4_t   *matrices   = calloc(sizeof(*matrices),   count);
+		float       *soa        = calloc(sizeof(*soa),        count * 10);
+
+		for (size_t i = 0; i < count; i++) {
+			transforms[i] = (transform_t) {
+				.position = { bench_random(-100, 100), bench_random(-100, 100), bench_random(-100, 100) },
+				.rotation = quaternion_normalize((quaternion_t) {
+						.w = bench_random(-1, 1), .x = bench_random(-1, 1),
+						.y = bench_random(-1, 1), .z = bench_random(-1, 1) }),
+				.scale    = { bench_random(0.1, 4), bench_random(0.1, 4), bench_random(0.1, 4) },
+			};
+			soa[count * 0 + i] = transforms[i].position.x;
+			soa[count * 1 + i] = transforms[i].position.y;
+			soa[count * 2 + i] = transforms[i].position.z;
+			soa[count * 3 + i] = transforms[i].rotation.w;
+			soa[count * 4 + i] = transforms[i].rotation.x;
+			soa[count * 5 + i] = transforms[i].rotation.y;
+			soa[count * 6 + i] = transforms[i].rotation.z;
+			soa[count * 7 + i] = transforms[i].scale.x;
+			soa[count * 8 + i] = transforms[i].scale.y;
+			soa[count * 9 + i] = transforms[i].scale.z;
+		}
+
+		lite_engine_gl_transform_soa_t input = {
+			soa + count * 0, soa + count * 1, soa + count * 2,
+			soa + count * 3, soa + count * 4, soa + count * 5, soa + count * 6,
+			soa + count * 7, soa + count * 8, soa + count * 9,
+		};
+
+		printf("%zu transforms, %zu iterations\n", count, iterations);
+
+		double start = bench_time();
+		for (size_t it = 0; it < iterations; it++) {
+			bench_reference(transforms, count);
+		}
+		double reference = (bench_time() - start) / (iterations * count) * 1e9;
+		printf("\t%-10s %8.2f ns/transform\n", "reference", reference);
+
+		for (size_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++) {
+			lite_engine_gl_transform_batch_use_kernel(kernels[k]);
+			const char *name = lite_engine_gl_transform_batch_kernel_name();
+
+			start = bench_time();
+			for (size_t it = 0; it < iterations; it++) {
+				lite_engine_gl_transform_batch_calculate_matrices(&input, matrices, count);
+			}
+			double batch = (bench_time() - start) / (iterations * count) * 1e9;
+
+			float error = 0.0f;
+			for (size_t i = 0; i < count; i++) {
+				for (int e = 0; e < 16; e++) {
+					error = fmaxf(error, fabsf(matrices[i].elements[e] - transforms[i].matrix.elements[e]));
+				}
+			}
+
+			printf("\t%-10s %8.2f ns/transform %6.2fx  max error %g\n",
+					name, batch, reference / batch, error);
+		}
+
+		free(transforms);
+		free(matrices);
+		free(soa);
+	}
+
+	return 0;
+}
@@ -4,17 +4,19 @@ int LIGHT_POINT = 0;
 int LIGHT_SPOT = 1;
 int LIGHT_DIRECTIONAL = 2;
 
+// std140 layout. every vec3 is followed by a scalar so the members pack
+// the same way as uniform_buffer_light_t in lite_engine_gl_uniform_buffer.c
 struct light_t {
-	int type;
     vec3 position;
-    vec3 direction;
-    float cutOff;
-    float outerCutOff;
     float constant;
+    vec3 direction;
     float linear;
-    float quadratic;
     vec3 diffuse;
+    float quadratic;
     vec3 specular;
+    float cutOff;
+    float outerCutOff;
+    int type;
 };
 
 struct Material {
@@ -29,10 +31,18 @@ in vec2 texCoord;
 
 out vec4 fragColor;
 
-uniform vec3 u_cameraPos;
+layout (std140) uniform lite_engine_frame {
+	mat4 u_viewMatrix;
+	mat4 u_projectionMatrix;
+	vec3 u_cameraPos;
+};
+
+layout (std140) uniform lite_engine_lights {
+	light_t u_light;
+	vec3 u_ambientLight;
+};
+
 uniform Material u_material;
-uniform vec3 u_ambientLight;
-uniform light_t u_light;
 
 vec3 lightDirectional(light_t light, vec3 normal, vec3 viewDir) {
     vec3 lightDir = normalize(-light.direction);
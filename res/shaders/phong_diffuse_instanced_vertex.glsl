@@ -0,0 +1,26 @@
+#version 410 core
+
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec2 aTexCoord;
+layout (location = 2) in vec3 aNormal;
+
+// per instance, see lite_engine_gl_instance_t
+layout (location = 3) in mat4 aModelMatrix;
+layout (location = 7) in mat3 aNormalMatrix;
+
+out vec2 texCoord;
+out vec3 normal;
+out vec3 fragPos;
+
+layout (std140) uniform lite_engine_frame {
+	mat4 u_viewMatrix;
+	mat4 u_projectionMatrix;
+	vec3 u_cameraPos;
+};
+
+void main(){
+	gl_Position = u_projectionMatrix * u_viewMatrix * aModelMatrix * vec4(aPos, 1.0);
+	texCoord = aTexCoord;
+	normal = aNormalMatrix * aNormal;
+	fragPos = vec3(aModelMatrix * vec4(aPos, 1.0));
+} 
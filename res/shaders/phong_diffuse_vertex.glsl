@@ -8,13 +8,18 @@ out vec2 texCoord;
 out vec3 normal;
 out vec3 fragPos;
 
+layout (std140) uniform lite_engine_frame {
+	mat4 u_viewMatrix;
+	mat4 u_projectionMatrix;
+	vec3 u_cameraPos;
+};
+
 uniform mat4 u_modelMatrix;
-uniform mat4 u_viewMatrix;
-uniform mat4 u_projectionMatrix;
+uniform mat3 u_normalMatrix; // inverse transpose of u_modelMatrix, built on the cpu
 
 void main(){
 	gl_Position = u_projectionMatrix * u_viewMatrix * u_modelMatrix * vec4(aPos, 1.0);
 	texCoord = aTexCoord;
-	normal = mat3(transpose(inverse(u_modelMatrix))) * aNormal; //TODO this is EXPENSIVE! do it on the cpu instead
+	normal = u_normalMatrix * aNormal;
 	fragPos = vec3(u_modelMatrix * vec4(aPos, 1.0));
 } 
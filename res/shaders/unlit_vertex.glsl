@@ -5,9 +5,13 @@ layout (location = 1) in vec2 aTexCoord;
 
 out vec2 texCoord;
 
+layout (std140) uniform lite_engine_frame {
+	mat4 u_viewMatrix;
+	mat4 u_projectionMatrix;
+	vec3 u_cameraPos;
+};
+
 uniform mat4 u_modelMatrix;
-uniform mat4 u_viewMatrix;
-uniform mat4 u_projectionMatrix;
 
 void main(){
 	gl_Position = u_projectionMatrix * u_viewMatrix * u_modelMatrix * vec4(aPos, 1.0);
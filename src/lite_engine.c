@@ -10,15 +10,22 @@
 typedef struct {
 	ui8     renderer;
 	ui8     is_running;
+	ui8     is_updating;
 	double  time_current;
 	ui64    frame_current;
 	double  time_delta;
 	double  time_last;
 	double  time_FPS;
+	ui64    tick_current;     // fixed steps simulated so far
+	double  tick_accumulator; // time not simulated yet, less than one step after an update
+	float   tick_alpha;       // tick_accumulator in steps, for interpolation
+	ui64    change_tick;      // what component writes are stamped with
 } lite_engine_context_t;
 
 static lite_engine_context_t *internal_engine_context = NULL;
 static ui8                    internal_preferred_api = LITE_ENGINE_RENDERER_GL;
+static double                 internal_tick_rate     = 60.0;
+static ui32                   internal_max_ticks     = 5;
 
 void lite_engine_use_render_api(ui8 api) {
 	switch(api) {
@@ -38,6 +45,45 @@ double lite_engine_get_time_delta(void) {
 	return internal_engine_context->time_delta;
 }
 
+ui64 lite_engine_get_frame(void) {
+	return internal_engine_context->frame_current;
+}
+
+// sets how many fixed steps are simulated per second, 60 by default.
+// LITE_ENGINE_SYSTEM_FIXED_STEP systems run at this rate whatever the frame
+// rate is.
+void lite_engine_set_tick_rate(double hz) {
+	if (hz <= 0) {
+		debug_error("tick rate has to be positive, got %lf", hz);
+		return;
+	}
+	internal_tick_rate = hz;
+}
+
+// caps the fixed steps one update may run, 5 by default. when a frame takes
+// longer than that many steps the time beyond is dropped and the simulation
+// runs slower than real time, instead of every frame taking longer than the
+// one before to catch up.
+void lite_engine_set_max_ticks_per_update(ui32 max_ticks) {
+	internal_max_ticks = max_ticks > 0 ? max_ticks : 1;
+}
+
+// the simulated time per fixed step. use this and not
+// lite_engine_get_time_delta in LITE_ENGINE_SYSTEM_FIXED_STEP systems.
+double lite_engine_get_tick_delta(void) {
+	return 1.0 / internal_tick_rate;
+}
+
+ui64 lite_engine_get_tick(void) {
+	return internal_engine_context->tick_current;
+}
+
+// how far the current frame is between the last two fixed steps, from 0 to
+// 1. renderers blend the state before and after the last step with it.
+float lite_engine_get_interpolation_alpha(void) {
+	return internal_engine_context->tick_alpha;
+}
+
 // initializes lite-engine. call this to rev up those fryers!
 void lite_engine_start(void) {
 	debug_log("Rev up those fryers!");
@@ -51,6 +97,15 @@ void lite_engine_start(void) {
 	internal_engine_context->time_delta    = 0;
 	internal_engine_context->time_last     = 0;
 	internal_engine_context->time_FPS      = 0;
+	internal_engine_context->tick_alpha    = 1;
+
+	{ // the first update measures from here, not from the epoch
+		struct timespec spec;
+		clock_gettime(CLOCK_MONOTONIC, &spec);
+		internal_engine_context->time_last = spec.tv_sec + spec.tv_nsec * 1e-9;
+	}
+
+	lite_engine_job_start(LITE_ENGINE_JOB_WORKERS_AUTO);
 
 	switch(internal_preferred_api) {
 		case LITE_ENGINE_RENDERER_GL: {
@@ -129,26 +184,64 @@ void internal_time_update(void) { // update time
 void lite_engine_update(void) {
 	// debug_log("running");
 
-	switch(internal_engine_context->renderer) {
-		case LITE_ENGINE_RENDERER_GL: {
-			lite_engine_gl_render();
-		} break;
-		case LITE_ENGINE_RENDERER_NONE: {
-		} break;
-		default: {
-			debug_error("Invalid render API. Enumeration does not represent a valid API");
-		} break;
+	lite_engine_context_t *context = internal_engine_context;
+
+	// the simulation runs in fixed steps for the time the last frame took.
+	// the accumulator is clamped so a slow frame can not snowball into ever
+	// more steps per frame.
+	double step = lite_engine_get_tick_delta();
+	context->tick_accumulator += context->time_delta;
+	if (context->tick_accumulator > step * internal_max_ticks) {
+		context->tick_accumulator = step * internal_max_ticks;
+	}
+
+	// every fixed step and every frame gets its own change tick, so change
+	// queries can tell them apart. the renderer registers its frame stages
+	// as systems in its start function.
+	context->is_updating = 1;
+	while (context->tick_accumulator >= step && context->is_running) {
+		lite_engine_component_set_change_tick(++context->change_tick);
+		lite_engine_system_run_fixed_step();
+		lite_engine_command_flush();
+
+		context->tick_accumulator -= step;
+		context->tick_current++;
+	}
+	context->tick_alpha = (float)(context->tick_accumulator / step);
+
+	lite_engine_component_set_change_tick(++context->change_tick);
+	if (context->is_running) {
+		lite_engine_system_run();
+	}
+	context->is_updating = 0;
+
+#if 0 // log the frame graph timings and critical path
+	lite_engine_system_log_timings();
+#endif // log the frame graph timings
+
+	// sync point, apply the structural changes systems recorded
+	lite_engine_command_flush();
+
+	if (!internal_engine_context->is_running) { // a system asked to stop
+		lite_engine_stop();
+		return;
 	}
 
 	internal_time_update();
 }
 
-// shut down and free all memory associated with the lite-engine context
+// shut down and free all memory associated with the lite-engine context.
+// when called from inside a system the shutdown is deferred until every
+// system of the current update has finished.
 void lite_engine_stop(void) {
-	debug_log("Shutting down...");
-
 	internal_engine_context->is_running = 0;
 
+	if (internal_engine_context->is_updating) {
+		return;
+	}
+
+	debug_log("Shutting down...");
+
 	switch(internal_engine_context->renderer) {
 		case LITE_ENGINE_RENDERER_GL: {
 			lite_engine_gl_stop();
@@ -159,5 +252,10 @@ void lite_engine_stop(void) {
 		} break;
 	}
 
+	lite_engine_job_stop();
+	lite_engine_system_free_all();
+	lite_engine_command_free_all();
+	lite_engine_entity_free_all();
+
 	debug_log("Shutdown complete");
 }
@@ -22,7 +22,163 @@ ui8    lite_engine_is_running     (void);
 void   lite_engine_update         (void);
 void   lite_engine_stop           (void);
 double lite_engine_get_time_delta (void);
+ui64   lite_engine_get_frame      (void);
+void   lite_engine_set_tick_rate  (double hz);
+void   lite_engine_set_max_ticks_per_update(ui32 max_ticks);
+double lite_engine_get_tick_delta (void);
+ui64   lite_engine_get_tick       (void);
+float  lite_engine_get_interpolation_alpha(void);
+
+// a handle that is never alive
+#define LITE_ENGINE_ENTITY_NONE 0
+
+#define LITE_ENGINE_COMPONENT_MAX      64
+#define LITE_ENGINE_COMPONENT_MASK(c)  ((ui64)1 << (c))
+
+typedef ui32 lite_engine_component_t;
+
+// walks the chunks matched by a query, see lite_engine_query_next
+typedef struct {
+	ui32        count;     // entities in the current chunk
+	const ui64 *entities;  // handles of the entities in the current chunk
+
+	ui32        query;
+	ui32        archetype;
+	ui32        next_archetype;
+	ui32        next_chunk;
+	ui8        *data;
+	ui64        changed;        // 0, or only visit chunks where one of these changed
+	ui64        changed_since;
+} lite_engine_query_iterator_t;
+
+// packed component pool for components that are added and removed often.
+// dense and components can be iterated directly, count entries each.
+typedef struct {
+	size_t      component_size;
+	ui64       *dense;
+	ui8        *components;
+	ui32        count;
+	ui32        capacity;
+	ui32      **pages;          // sparse entity index -> dense position
+	ui32        page_count;
+} lite_engine_sparse_set_t;
+
+#define LITE_ENGINE_SPARSE_SET_JOIN_MAX 8
+
+typedef struct {
+	ui64        entity;
+	void       *components[LITE_ENGINE_SPARSE_SET_JOIN_MAX];
+
+	lite_engine_sparse_set_t *sets[LITE_ENGINE_SPARSE_SET_JOIN_MAX];
+	ui32        set_count;
+	ui32        driver;
+	ui32        next;
+} lite_engine_sparse_set_join_t;
+
+typedef void (*lite_engine_job_function_t)   (void *data);
+typedef void (*lite_engine_job_range_function_t)(void *data, ui32 begin, ui32 end);
+typedef void (*lite_engine_system_function_t)(void *data);
+
+#define LITE_ENGINE_JOB_WORKERS_AUTO UINT32_MAX
+
+// number of unfinished jobs submitted with it, see lite_engine_job_wait
+typedef struct {
+	ui32 value;
+} lite_engine_job_counter_t;
+
+enum {
+	LITE_ENGINE_SYSTEM_MAIN_THREAD = 1 << 0, // never run on a worker, e.g. GL submission
+	LITE_ENGINE_SYSTEM_FIXED_STEP  = 1 << 1, // runs once per simulation tick, not once per frame
+};
+
+#define LITE_ENGINE_SYSTEM_NONE UINT32_MAX
+
+// how one system ran during the last lite_engine_system_run. times are in
+// seconds from the start of the run. the critical path is the chain of
+// systems that each held up the next one, ending at the last to finish.
+typedef struct {
+	const char *name;
+	double      start;
+	double      duration;
+	ui32        gated_by;       // the dependency that finished last, or LITE_ENGINE_SYSTEM_NONE
+	ui8         critical;
+} lite_engine_system_timing_t;
+
+void   lite_engine_job_start      (ui32 worker_count);
+void   lite_engine_job_stop       (void);
+void   lite_engine_job_submit     (lite_engine_job_function_t function, void *data);
+void   lite_engine_job_submit_counted(lite_engine_job_function_t function, void *data,
+                                   lite_engine_job_counter_t *counter);
+void   lite_engine_job_wait       (lite_engine_job_counter_t *counter);
+ui8    lite_engine_job_run_one    (void);
+void   lite_engine_job_parallel_for(ui32 count, ui32 batch_size,
+                                   lite_engine_job_range_function_t function, void *data);
+ui32   lite_engine_job_get_worker_count(void);
+
+ui32   lite_engine_system_register(const char *name, lite_engine_system_function_t function,
+                                   void *data, ui64 read, ui64 write, ui8 flags);
+void   lite_engine_system_depend  (ui32 system, ui32 after);
+void   lite_engine_system_run     (void);
+void   lite_engine_system_run_fixed_step(void);
+ui32   lite_engine_system_get_count(void);
+lite_engine_system_timing_t
+       lite_engine_system_get_timing(ui32 system);
+double lite_engine_system_get_frame_time(void);
+void   lite_engine_system_log_timings(void);
+void   lite_engine_system_free_all(void);
+
+ui64   lite_engine_command_create (void);
+void   lite_engine_command_destroy(ui64 entity);
+void   lite_engine_command_add_component   (ui64 entity, lite_engine_component_t component, const void *data);
+void   lite_engine_command_remove_component(ui64 entity, lite_engine_component_t component);
+void   lite_engine_command_flush  (void);
+void   lite_engine_command_free_all(void);
 
 ui64   lite_engine_entity_create  (void);
+ui64   lite_engine_entity_reserve (void);
+void   lite_engine_entity_flush_reserved(void);
+void   lite_engine_entity_destroy (ui64 entity);
+ui8    lite_engine_entity_is_alive(ui64 entity);
+ui32   lite_engine_entity_index   (ui64 entity);
+ui32   lite_engine_entity_generation(ui64 entity);
+const ui64 *
+       lite_engine_entity_get_live(ui32 *count);
+ui32   lite_engine_entity_get_slot_count(void);
+void   lite_engine_entity_set_destroy_callback(void (*callback)(ui64 entity));
+void   lite_engine_entity_free_all(void);
+
+lite_engine_component_t
+       lite_engine_component_register(size_t size);
+size_t lite_engine_component_get_size(lite_engine_component_t component);
+void   lite_engine_component_set_change_tick(ui64 tick);
+ui64   lite_engine_component_get_change_tick(void);
+void  *lite_engine_entity_add_component   (ui64 entity, lite_engine_component_t component, const void *data);
+void   lite_engine_entity_remove_component(ui64 entity, lite_engine_component_t component);
+void   lite_engine_entity_change_components(ui64 entity, ui64 add, ui64 remove);
+void  *lite_engine_entity_get_component   (ui64 entity, lite_engine_component_t component);
+void  *lite_engine_entity_get_component_write(ui64 entity, lite_engine_component_t component);
+ui8    lite_engine_entity_has_component   (ui64 entity, lite_engine_component_t component);
+
+ui32   lite_engine_query_create   (ui64 all, ui64 none);
+ui32   lite_engine_query_count    (ui32 query);
+lite_engine_query_iterator_t
+       lite_engine_query_iterate  (ui32 query);
+lite_engine_query_iterator_t
+       lite_engine_query_iterate_changed(ui32 query, ui64 changed, ui64 since);
+ui8    lite_engine_query_next     (lite_engine_query_iterator_t *it);
+void  *lite_engine_query_column   (const lite_engine_query_iterator_t *it, lite_engine_component_t component);
+void  *lite_engine_query_column_write(const lite_engine_query_iterator_t *it, lite_engine_component_t component);
+
+lite_engine_sparse_set_t *
+       lite_engine_sparse_set_create   (size_t component_size);
+void   lite_engine_sparse_set_free     (lite_engine_sparse_set_t *set);
+void  *lite_engine_sparse_set_add      (lite_engine_sparse_set_t *set, ui64 entity, const void *data);
+void   lite_engine_sparse_set_remove   (lite_engine_sparse_set_t *set, ui64 entity);
+void   lite_engine_sparse_set_clear    (lite_engine_sparse_set_t *set);
+void  *lite_engine_sparse_set_get      (const lite_engine_sparse_set_t *set, ui64 entity);
+ui8    lite_engine_sparse_set_has      (const lite_engine_sparse_set_t *set, ui64 entity);
+lite_engine_sparse_set_join_t
+       lite_engine_sparse_set_join     (lite_engine_sparse_set_t **sets, ui32 set_count);
+ui8    lite_engine_sparse_set_join_next(lite_engine_sparse_set_join_t *join);
 
 #endif
@@ -1,8 +1,934 @@
 #include "lite_engine.h"
 
-static ui64 internal_entities_count;
+#include <string.h>
+
+// entity handles are 64 bits wide. the low 32 bits are the slot index and the
+// high 32 bits are the generation that slot had when the handle was created.
+// destroying an entity bumps the slot's generation, so old handles stop
+// resolving once the slot is recycled. generations start at 1 so that a
+// zeroed handle (LITE_ENGINE_ENTITY_NONE) is never alive.
+//
+// live entities are also kept in a dense array so iterating them never
+// touches dead slots.
+//
+// components are stored by archetype: every entity with the exact same set of
+// components lives in the same archetype, packed into 16 KiB chunks. a chunk
+// holds the entity handles followed by one tightly packed column per
+// component, so a system only pulls the columns it reads into the cache.
+// adding or removing a component moves the entity to another archetype.
+//
+// every chunk also remembers, per component, the change tick of the last
+// write to that column. writes are stamped with the engine frame, so systems
+// can skip chunks nothing touched since they last looked. a column counts as
+// written when it is fetched through one of the *_write accessors or when an
+// entity moves into the chunk.
+
+#define ECS_CHUNK_SIZE      (16 * 1024)
+#define ECS_COLUMN_ALIGN    16
+#define ECS_NONE            UINT32_MAX
+
+typedef struct {
+	ui32 archetype;     // ECS_NONE while the entity has no components
+	ui32 chunk;
+	ui32 row;
+} entity_location_t;
+
+typedef struct {
+	ui8               *data;        // ECS_CHUNK_SIZE bytes
+	ui32               count;
+	ui64               versions[LITE_ENGINE_COMPONENT_MAX]; // change tick of the last write per column
+} archetype_chunk_t;
+
+typedef struct {
+	ui64               mask;
+	ui32               capacity;    // entities per chunk
+	ui32               column_offsets[LITE_ENGINE_COMPONENT_MAX]; // ECS_NONE if absent
+	archetype_chunk_t *chunks;
+	ui32               chunk_count;
+	ui32               chunk_capacity;
+	ui32               edges_add   [LITE_ENGINE_COMPONENT_MAX]; // archetype reached by adding
+	ui32               edges_remove[LITE_ENGINE_COMPONENT_MAX]; // or removing a component
+} archetype_t;
+
+typedef struct {
+	ui64               all;
+	ui64               none;
+	ui32              *archetypes;  // cached list of matching archetypes
+	ui32               archetype_count;
+	ui32               archetype_capacity;
+	ui32               archetypes_seen; // archetypes tested so far
+} query_t;
+
+typedef struct {
+	size_t             component_sizes[LITE_ENGINE_COMPONENT_MAX];
+	ui32               component_count;
+
+	archetype_t       *archetypes;
+	ui32               archetype_count;
+	ui32               archetype_capacity;
+
+	query_t           *queries;
+	ui32               query_count;
+	ui32               query_capacity;
+
+	ui64               change_tick;
+} component_registry_t;
+
+static component_registry_t internal_components;
+
+// every live sparse set, so destroyed entities can be dropped from all of them
+typedef struct {
+	lite_engine_sparse_set_t **sets;
+	ui32                       count;
+	ui32                       capacity;
+} sparse_set_registry_t;
+
+static sparse_set_registry_t internal_sparse_sets;
+
+typedef struct {
+	ui32              *generations; // per slot
+	entity_location_t *locations;   // per slot
+	ui32              *live_index;  // per slot, position in 'live' while the slot is alive
+	ui32               slot_count;
+	ui32               slot_capacity;
+
+	ui32              *free_slots;  // stack of destroyed slots waiting to be reused
+	ui32               free_count;
+	ui32               free_capacity;
+	int64_t            free_cursor; // free_count minus the handles reserved since the last flush
+
+	ui64              *live;
+	ui32               live_count;
+	ui32               live_capacity;
+
+	void (*destroy_callback)(ui64 entity);
+} entity_registry_t;
+
+static entity_registry_t internal_entities;
+
+static ui64 internal_entity_make(ui32 index, ui32 generation) {
+	return (ui64)index | ((ui64)generation << 32);
+}
+
+ui32 lite_engine_entity_index(ui64 entity) {
+	return (ui32)(entity & 0xffffffff);
+}
+
+ui32 lite_engine_entity_generation(ui64 entity) {
+	return (ui32)(entity >> 32);
+}
+
+// hands out a handle without touching the registry, so it is safe to call from
+// any thread while systems run. the handle can be stored and passed to
+// command buffers right away but only becomes alive at the next
+// lite_engine_entity_flush_reserved, which the command buffer flush does.
+//
+// reservations take slots off the free list through an atomic cursor. once
+// the free list is used up the cursor goes negative and counts slots past
+// the end of the registry.
+ui64 lite_engine_entity_reserve(void) {
+	entity_registry_t *r = &internal_entities;
+
+	int64_t cursor = __atomic_sub_fetch(&r->free_cursor, 1, __ATOMIC_RELAXED);
+	if (cursor >= 0) {
+		ui32 index = r->free_slots[cursor];
+		return internal_entity_make(index, r->generations[index]);
+	}
+
+	return internal_entity_make(r->slot_count + (ui32)(-cursor - 1), 1);
+}
+
+static void internal_entity_make_live(ui32 index) {
+	entity_registry_t *r = &internal_entities;
+
+	if (r->live_count >= r->live_capacity) {
+		r->live_capacity = r->live_capacity * 2 + 1024;
+		r->live          = realloc(r->live, sizeof(*r->live) * r->live_capacity);
+	}
+
+	r->locations[index]      = (entity_location_t) { .archetype = ECS_NONE };
+	r->live_index[index]     = r->live_count;
+	r->live[r->live_count++] = internal_entity_make(index, r->generations[index]);
+}
+
+// makes every reserved handle alive. must not run concurrently with anything
+// else touching entities.
+void lite_engine_entity_flush_reserved(void) {
+	entity_registry_t *r = &internal_entities;
+
+	int64_t cursor = r->free_cursor;
+	if (cursor == (int64_t)r->free_count) {
+		return;
+	}
+
+	ui32 reused = cursor >= 0 ? (ui32)cursor : 0;
+	for (ui32 i = reused; i < r->free_count; i++) {
+		internal_entity_make_live(r->free_slots[i]);
+	}
+	r->free_count = reused;
+
+	if (cursor < 0) {
+		ui32 added = (ui32)-cursor;
+		if (r->slot_count + added > r->slot_capacity) {
+			r->slot_capacity = (r->slot_count + added) * 2 + 1024;
+			r->generations   = realloc(r->generations, sizeof(*r->generations) * r->slot_capacity);
+			r->live_index    = realloc(r->live_index,  sizeof(*r->live_index)  * r->slot_capacity);
+			r->locations     = realloc(r->locations,   sizeof(*r->locations)   * r->slot_capacity);
+		}
+		for (ui32 i = 0; i < added; i++) {
+			r->generations[r->slot_count] = 1;
+			internal_entity_make_live(r->slot_count++);
+		}
+	}
+
+	r->free_cursor = r->free_count;
+}
 
 ui64 lite_engine_entity_create(void) {
-	internal_entities_count++;
-	return internal_entities_count;	
+	lite_engine_entity_flush_reserved();
+	ui64 entity = lite_engine_entity_reserve();
+	lite_engine_entity_flush_reserved();
+	return entity;
+}
+
+ui8 lite_engine_entity_is_alive(ui64 entity) {
+	entity_registry_t *r = &internal_entities;
+	ui32 index = lite_engine_entity_index(entity);
+	return index < r->slot_count &&
+		r->generations[index] == lite_engine_entity_generation(entity) &&
+		r->live_index[index] != ECS_NONE; // reserved but not flushed yet
+}
+
+static void internal_archetype_remove(entity_location_t location);
+
+// destroys an entity and recycles its slot. handles to it held anywhere else
+// become stale and lite_engine_entity_is_alive will return 0 for them.
+void lite_engine_entity_destroy(ui64 entity) {
+	entity_registry_t *r = &internal_entities;
+
+	lite_engine_entity_flush_reserved();
+
+	if (!lite_engine_entity_is_alive(entity)) {
+		debug_warn("tried to destroy an entity that is not alive (index %u generation %u)",
+				lite_engine_entity_index(entity), lite_engine_entity_generation(entity));
+		return;
+	}
+
+	if (r->destroy_callback != NULL) {
+		r->destroy_callback(entity);
+	}
+
+	ui32 index = lite_engine_entity_index(entity);
+
+	if (r->locations[index].archetype != ECS_NONE) {
+		internal_archetype_remove(r->locations[index]);
+		r->locations[index].archetype = ECS_NONE;
+	}
+
+	for (ui32 i = 0; i < internal_sparse_sets.count; i++) {
+		lite_engine_sparse_set_remove(internal_sparse_sets.sets[i], entity);
+	}
+
+	{ // swap remove from the live array
+		ui32 position = r->live_index[index];
+		ui64 last     = r->live[--r->live_count];
+		r->live[position] = last;
+		r->live_index[lite_engine_entity_index(last)] = position;
+		r->live_index[index] = ECS_NONE;
+	}
+
+	r->generations[index]++;
+	if (r->generations[index] == 0) { // wrapped, skip the invalid generation
+		r->generations[index] = 1;
+	}
+
+	if (r->free_count >= r->free_capacity) {
+		r->free_capacity = r->free_capacity * 2 + 1024;
+		r->free_slots    = realloc(r->free_slots, sizeof(*r->free_slots) * r->free_capacity);
+	}
+	r->free_slots[r->free_count++] = index;
+	r->free_cursor = r->free_count;
+}
+
+// returns the dense array of live entity handles. the pointer is only valid
+// until the next call to lite_engine_entity_create or lite_engine_entity_destroy.
+const ui64 *lite_engine_entity_get_live(ui32 *count) {
+	*count = internal_entities.live_count;
+	return internal_entities.live;
+}
+
+// number of slots handed out so far. every live entity index is below this,
+// so it is the size per-entity component storage has to cover.
+ui32 lite_engine_entity_get_slot_count(void) {
+	return internal_entities.slot_count;
+}
+
+// called with the entity still alive, right before it is destroyed.
+void lite_engine_entity_set_destroy_callback(void (*callback)(ui64 entity)) {
+	internal_entities.destroy_callback = callback;
+}
+
+void lite_engine_entity_free_all(void) {
+	component_registry_t *c = &internal_components;
+	for (ui32 a = 0; a < c->archetype_count; a++) {
+		for (ui32 k = 0; k < c->archetypes[a].chunk_count; k++) {
+			free(c->archetypes[a].chunks[k].data);
+		}
+		free(c->archetypes[a].chunks);
+	}
+	for (ui32 q = 0; q < c->query_count; q++) {
+		free(c->queries[q].archetypes);
+	}
+	free(c->archetypes);
+	free(c->queries);
+	*c = (component_registry_t) {0};
+
+	while (internal_sparse_sets.count > 0) {
+		lite_engine_sparse_set_free(internal_sparse_sets.sets[0]);
+	}
+	free(internal_sparse_sets.sets);
+	internal_sparse_sets = (sparse_set_registry_t) {0};
+
+	free(internal_entities.generations);
+	free(internal_entities.locations);
+	free(internal_entities.live_index);
+	free(internal_entities.free_slots);
+	free(internal_entities.live);
+	internal_entities = (entity_registry_t) {0};
+}
+
+// registers a component type and returns its id. components are plain data
+// copied with memcpy and must not need more than 16 byte alignment.
+lite_engine_component_t lite_engine_component_register(size_t size) {
+	component_registry_t *c = &internal_components;
+
+	if (c->component_count >= LITE_ENGINE_COMPONENT_MAX) {
+		debug_error("too many component types, the limit is %d", LITE_ENGINE_COMPONENT_MAX);
+		assert(0);
+	}
+
+	c->component_sizes[c->component_count] = size;
+	return c->component_count++;
+}
+
+static ui32 internal_archetype_create(ui64 mask) {
+	component_registry_t *c = &internal_components;
+
+	if (c->archetype_count >= c->archetype_capacity) {
+		c->archetype_capacity = c->archetype_capacity * 2 + 16;
+		c->archetypes         = realloc(c->archetypes, sizeof(*c->archetypes) * c->archetype_capacity);
+	}
+
+	archetype_t *a = &c->archetypes[c->archetype_count];
+	*a = (archetype_t) { .mask = mask };
+
+	size_t entity_size = sizeof(ui64);
+	ui32   columns     = 0;
+	for (ui32 k = 0; k < LITE_ENGINE_COMPONENT_MAX; k++) {
+		a->column_offsets[k] = ECS_NONE;
+		a->edges_add[k]      = ECS_NONE;
+		a->edges_remove[k]   = ECS_NONE;
+		if (mask & LITE_ENGINE_COMPONENT_MASK(k)) {
+			entity_size += c->component_sizes[k];
+			columns++;
+		}
+	}
+
+	// leave room for padding every column up to ECS_COLUMN_ALIGN
+	a->capacity = (ECS_CHUNK_SIZE - columns * ECS_COLUMN_ALIGN) / entity_size;
+	if (a->capacity == 0) {
+		debug_error("archetype 0x%lx does not fit in a %d byte chunk",
+				(unsigned long)mask, ECS_CHUNK_SIZE);
+		assert(0);
+	}
+
+	size_t offset = sizeof(ui64) * a->capacity;
+	for (ui32 k = 0; k < LITE_ENGINE_COMPONENT_MAX; k++) {
+		if (mask & LITE_ENGINE_COMPONENT_MASK(k)) {
+			offset = (offset + ECS_COLUMN_ALIGN - 1) & ~(size_t)(ECS_COLUMN_ALIGN - 1);
+			a->column_offsets[k] = offset;
+			offset += c->component_sizes[k] * a->capacity;
+		}
+	}
+	assert(offset <= ECS_CHUNK_SIZE);
+
+	return c->archetype_count++;
+}
+
+static ui32 internal_archetype_find(ui64 mask) {
+	component_registry_t *c = &internal_components;
+	for (ui32 a = 0; a < c->archetype_count; a++) {
+		if (c->archetypes[a].mask == mask) {
+			return a;
+		}
+	}
+	return internal_archetype_create(mask);
+}
+
+// stamps every column of a chunk with the current change tick
+static void internal_chunk_touch(const archetype_t *a, archetype_chunk_t *chunk) {
+	for (ui64 mask = a->mask; mask != 0; mask &= mask - 1) {
+		chunk->versions[__builtin_ctzll(mask)] = internal_components.change_tick;
+	}
+}
+
+// appends an entity to the last chunk of an archetype, adding a chunk if it is full.
+static entity_location_t internal_archetype_push(ui32 archetype, ui64 entity) {
+	archetype_t *a = &internal_components.archetypes[archetype];
+
+	if (a->chunk_count == 0 || a->chunks[a->chunk_count - 1].count >= a->capacity) {
+		if (a->chunk_count >= a->chunk_capacity) {
+			a->chunk_capacity = a->chunk_capacity * 2 + 4;
+			a->chunks         = realloc(a->chunks, sizeof(*a->chunks) * a->chunk_capacity);
+		}
+		archetype_chunk_t *chunk = &a->chunks[a->chunk_count++];
+		*chunk = (archetype_chunk_t) {0};
+		if (posix_memalign((void **)&chunk->data, 64, ECS_CHUNK_SIZE) != 0) {
+			debug_error("failed to allocate archetype chunk");
+			assert(0);
+		}
+	}
+
+	ui32               chunk_index = a->chunk_count - 1;
+	archetype_chunk_t *chunk       = &a->chunks[chunk_index];
+	ui32               row         = chunk->count++;
+
+	((ui64 *)chunk->data)[row] = entity;
+	internal_chunk_touch(a, chunk);
+
+	return (entity_location_t) {
+		.archetype = archetype,
+		.chunk     = chunk_index,
+		.row       = row,
+	};
+}
+
+// removes the row at 'location' by moving the archetype's very last row into
+// it, which keeps every chunk but the last one full.
+static void internal_archetype_remove(entity_location_t location) {
+	component_registry_t *c    = &internal_components;
+	archetype_t          *a    = &c->archetypes[location.archetype];
+	archetype_chunk_t    *last = &a->chunks[a->chunk_count - 1];
+	archetype_chunk_t    *hole = &a->chunks[location.chunk];
+	ui32                  last_row = last->count - 1;
+
+	if (hole != last || location.row != last_row) {
+		ui64 moved = ((ui64 *)last->data)[last_row];
+		((ui64 *)hole->data)[location.row] = moved;
+
+		for (ui32 k = 0; k < LITE_ENGINE_COMPONENT_MAX; k++) {
+			if (a->column_offsets[k] == ECS_NONE) {
+				continue;
+			}
+			size_t size = c->component_sizes[k];
+			memcpy(hole->data + a->column_offsets[k] + size * location.row,
+					last->data + a->column_offsets[k] + size * last_row, size);
+		}
+
+		internal_entities.locations[lite_engine_entity_index(moved)] = location;
+		internal_chunk_touch(a, hole);
+	}
+
+	last->count--;
+	if (last->count == 0) {
+		free(last->data);
+		a->chunk_count--;
+	}
+}
+
+static void *internal_component_pointer(entity_location_t location, lite_engine_component_t component) {
+	archetype_t *a      = &internal_components.archetypes[location.archetype];
+	ui32         offset = a->column_offsets[component];
+	if (offset == ECS_NONE) {
+		return NULL;
+	}
+	return a->chunks[location.chunk].data + offset +
+		internal_components.component_sizes[component] * location.row;
+}
+
+// moves an entity to 'archetype', copying every component both archetypes share.
+static void internal_entity_move(ui64 entity, ui32 archetype) {
+	component_registry_t *c     = &internal_components;
+	ui32                  index = lite_engine_entity_index(entity);
+	entity_location_t     from  = internal_entities.locations[index];
+	entity_location_t     to    = internal_archetype_push(archetype, entity);
+
+	if (from.archetype != ECS_NONE) {
+		ui64 shared = c->archetypes[from.archetype].mask & c->archetypes[archetype].mask;
+		for (ui32 k = 0; k < LITE_ENGINE_COMPONENT_MAX; k++) {
+			if (shared & LITE_ENGINE_COMPONENT_MASK(k)) {
+				memcpy(internal_component_pointer(to, k),
+						internal_component_pointer(from, k), c->component_sizes[k]);
+			}
+		}
+		internal_archetype_remove(from);
+	}
+
+	internal_entities.locations[index] = to;
+}
+
+// adds a component to an entity and returns a pointer to it. 'data' is copied
+// in when it is not NULL, otherwise the component is zeroed. if the entity
+// already has the component it is overwritten in place.
+//
+// adding or removing components moves entities between chunks, which
+// invalidates component pointers and any query iteration in progress.
+void *lite_engine_entity_add_component(ui64 entity, lite_engine_component_t component, const void *data) {
+	assert(lite_engine_entity_is_alive(entity));
+	assert(component < internal_components.component_count);
+
+	component_registry_t *c        = &internal_components;
+	entity_location_t     location = internal_entities.locations[lite_engine_entity_index(entity)];
+
+	if (location.archetype == ECS_NONE) {
+		internal_entity_move(entity, internal_archetype_find(LITE_ENGINE_COMPONENT_MASK(component)));
+	} else if ((c->archetypes[location.archetype].mask & LITE_ENGINE_COMPONENT_MASK(component)) == 0) {
+		ui32 archetype = c->archetypes[location.archetype].edges_add[component];
+		if (archetype == ECS_NONE) {
+			archetype = internal_archetype_find(
+					c->archetypes[location.archetype].mask | LITE_ENGINE_COMPONENT_MASK(component));
+			c->archetypes[location.archetype].edges_add[component] = archetype;
+			c->archetypes[archetype].edges_remove[component] = location.archetype;
+		}
+		internal_entity_move(entity, archetype);
+	}
+
+	entity_location_t now     = internal_entities.locations[lite_engine_entity_index(entity)];
+	void             *pointer = internal_component_pointer(now, component);
+	c->archetypes[now.archetype].chunks[now.chunk].versions[component] = c->change_tick;
+	if (data != NULL) {
+		memcpy(pointer, data, c->component_sizes[component]);
+	} else {
+		memset(pointer, 0, c->component_sizes[component]);
+	}
+	return pointer;
+}
+
+void lite_engine_entity_remove_component(ui64 entity, lite_engine_component_t component) {
+	assert(lite_engine_entity_is_alive(entity));
+
+	component_registry_t *c        = &internal_components;
+	ui32                  index    = lite_engine_entity_index(entity);
+	entity_location_t     location = internal_entities.locations[index];
+
+	if (location.archetype == ECS_NONE ||
+			(c->archetypes[location.archetype].mask & LITE_ENGINE_COMPONENT_MASK(component)) == 0) {
+		return;
+	}
+
+	ui64 mask = c->archetypes[location.archetype].mask & ~LITE_ENGINE_COMPONENT_MASK(component);
+	if (mask == 0) {
+		internal_archetype_remove(location);
+		internal_entities.locations[index].archetype = ECS_NONE;
+		return;
+	}
+
+	ui32 archetype = c->archetypes[location.archetype].edges_remove[component];
+	if (archetype == ECS_NONE) {
+		archetype = internal_archetype_find(mask);
+		c->archetypes[location.archetype].edges_remove[component] = archetype;
+		c->archetypes[archetype].edges_add[component] = location.archetype;
+	}
+	internal_entity_move(entity, archetype);
+}
+
+// adds every component in 'add' and removes every component in 'remove' with a
+// single move between archetypes. added components are zeroed, components the
+// entity already had keep their value.
+void lite_engine_entity_change_components(ui64 entity, ui64 add, ui64 remove) {
+	assert(lite_engine_entity_is_alive(entity));
+
+	component_registry_t *c        = &internal_components;
+	ui32                  index    = lite_engine_entity_index(entity);
+	entity_location_t     location = internal_entities.locations[index];
+	ui64                  mask     = location.archetype == ECS_NONE ? 0 : c->archetypes[location.archetype].mask;
+	ui64                  target   = (mask & ~remove) | add;
+
+	if (target == mask) {
+		return;
+	}
+
+	if (target == 0) {
+		internal_archetype_remove(location);
+		internal_entities.locations[index].archetype = ECS_NONE;
+		return;
+	}
+
+	internal_entity_move(entity, internal_archetype_find(target));
+
+	location = internal_entities.locations[index];
+	for (ui32 k = 0; k < LITE_ENGINE_COMPONENT_MAX; k++) {
+		if ((target & ~mask) & LITE_ENGINE_COMPONENT_MASK(k)) {
+			memset(internal_component_pointer(location, k), 0, c->component_sizes[k]);
+		}
+	}
+}
+
+size_t lite_engine_component_get_size(lite_engine_component_t component) {
+	assert(component < internal_components.component_count);
+	return internal_components.component_sizes[component];
+}
+
+// returns the entity's component, or NULL if it does not have one.
+void *lite_engine_entity_get_component(ui64 entity, lite_engine_component_t component) {
+	assert(lite_engine_entity_is_alive(entity));
+
+	entity_location_t location = internal_entities.locations[lite_engine_entity_index(entity)];
+	if (location.archetype == ECS_NONE) {
+		return NULL;
+	}
+	return internal_component_pointer(location, component);
+}
+
+// like lite_engine_entity_get_component, but marks the component as changed.
+void *lite_engine_entity_get_component_write(ui64 entity, lite_engine_component_t component) {
+	assert(lite_engine_entity_is_alive(entity));
+
+	entity_location_t location = internal_entities.locations[lite_engine_entity_index(entity)];
+	if (location.archetype == ECS_NONE) {
+		return NULL;
+	}
+
+	void *pointer = internal_component_pointer(location, component);
+	if (pointer != NULL) {
+		internal_components.archetypes[location.archetype].chunks[location.chunk].versions[component] =
+			internal_components.change_tick;
+	}
+	return pointer;
+}
+
+// sets the tick writes are stamped with. the engine bumps it before every
+// fixed step and before the frame systems of every update.
+void lite_engine_component_set_change_tick(ui64 tick) {
+	internal_components.change_tick = tick;
+}
+
+ui64 lite_engine_component_get_change_tick(void) {
+	return internal_components.change_tick;
+}
+
+ui8 lite_engine_entity_has_component(ui64 entity, lite_engine_component_t component) {
+	return lite_engine_entity_get_component(entity, component) != NULL;
+}
+
+// creates a query matching every archetype that has all components in 'all'
+// and none of the components in 'none'. queries live until
+// lite_engine_entity_free_all.
+ui32 lite_engine_query_create(ui64 all, ui64 none) {
+	component_registry_t *c = &internal_components;
+
+	if (c->query_count >= c->query_capacity) {
+		c->query_capacity = c->query_capacity * 2 + 16;
+		c->queries        = realloc(c->queries, sizeof(*c->queries) * c->query_capacity);
+	}
+
+	c->queries[c->query_count] = (query_t) {
+		.all  = all,
+		.none = none,
+	};
+	return c->query_count++;
+}
+
+// the matching archetype list is cached per query. archetypes are never
+// destroyed, so the cache is only stale when new archetypes were created
+// since the last refresh, and then only those new ones are tested.
+static query_t *internal_query_refresh(ui32 query) {
+	component_registry_t *c = &internal_components;
+	query_t              *q = &c->queries[query];
+
+	for (; q->archetypes_seen < c->archetype_count; q->archetypes_seen++) {
+		ui64 mask = c->archetypes[q->archetypes_seen].mask;
+		if ((mask & q->all) != q->all || (mask & q->none) != 0) {
+			continue;
+		}
+		if (q->archetype_count >= q->archetype_capacity) {
+			q->archetype_capacity = q->archetype_capacity * 2 + 8;
+			q->archetypes         = realloc(q->archetypes, sizeof(*q->archetypes) * q->archetype_capacity);
+		}
+		q->archetypes[q->archetype_count++] = q->archetypes_seen;
+	}
+
+	return q;
+}
+
+// number of entities the query currently matches.
+ui32 lite_engine_query_count(ui32 query) {
+	query_t *q     = internal_query_refresh(query);
+	ui32     count = 0;
+	for (ui32 i = 0; i < q->archetype_count; i++) {
+		archetype_t *a = &internal_components.archetypes[q->archetypes[i]];
+		for (ui32 k = 0; k < a->chunk_count; k++) {
+			count += a->chunks[k].count;
+		}
+	}
+	return count;
+}
+
+lite_engine_query_iterator_t lite_engine_query_iterate(ui32 query) {
+	internal_query_refresh(query);
+	return (lite_engine_query_iterator_t) {
+		.query = query,
+	};
+}
+
+// like lite_engine_query_iterate, but only visits chunks where at least one
+// of the components in 'changed' was written at or after tick 'since'. a
+// system that stores lite_engine_component_get_change_tick() each time it
+// runs and passes it back as 'since' sees every change at least once.
+lite_engine_query_iterator_t lite_engine_query_iterate_changed(ui32 query, ui64 changed, ui64 since) {
+	internal_query_refresh(query);
+	return (lite_engine_query_iterator_t) {
+		.query         = query,
+		.changed       = changed,
+		.changed_since = since,
+	};
+}
+
+// advances to the next matching chunk. returns 0 once every chunk was visited.
+//
+//	lite_engine_query_iterator_t it = lite_engine_query_iterate(query);
+//	while (lite_engine_query_next(&it)) {
+//		transform_t *transforms = lite_engine_query_column(&it, transform);
+//		for (ui32 i = 0; i < it.count; i++) { ... }
+//	}
+ui8 lite_engine_query_next(lite_engine_query_iterator_t *it) {
+	query_t *q = &internal_components.queries[it->query];
+
+	while (it->next_archetype < q->archetype_count) {
+		archetype_t *a = &internal_components.archetypes[q->archetypes[it->next_archetype]];
+		if (it->next_chunk < a->chunk_count) {
+			archetype_chunk_t *chunk = &a->chunks[it->next_chunk++];
+
+			if (it->changed != 0) {
+				ui8 changed = 0;
+				for (ui64 mask = it->changed & a->mask; mask != 0; mask &= mask - 1) {
+					if (chunk->versions[__builtin_ctzll(mask)] >= it->changed_since) {
+						changed = 1;
+						break;
+					}
+				}
+				if (!changed) {
+					continue;
+				}
+			}
+
+			it->archetype = q->archetypes[it->next_archetype];
+			it->data      = chunk->data;
+			it->count     = chunk->count;
+			it->entities  = (const ui64 *)chunk->data;
+			return 1;
+		}
+		it->next_archetype++;
+		it->next_chunk = 0;
+	}
+
+	return 0;
+}
+
+// returns the tightly packed array of 'component' in the current chunk, or
+// NULL if the chunk's archetype does not have it. use
+// lite_engine_query_column_write when the column is going to be modified.
+void *lite_engine_query_column(const lite_engine_query_iterator_t *it, lite_engine_component_t component) {
+	ui32 offset = internal_components.archetypes[it->archetype].column_offsets[component];
+	if (offset == ECS_NONE) {
+		return NULL;
+	}
+	return it->data + offset;
+}
+
+// like lite_engine_query_column, but marks the column of the current chunk as changed.
+void *lite_engine_query_column_write(const lite_engine_query_iterator_t *it, lite_engine_component_t component) {
+	archetype_t *a      = &internal_components.archetypes[it->archetype];
+	ui32         offset = a->column_offsets[component];
+	if (offset == ECS_NONE) {
+		return NULL;
+	}
+	a->chunks[it->next_chunk - 1].versions[component] = internal_components.change_tick;
+	return it->data + offset;
+}
+
+// sparse set component pools. meant for components that are added and removed
+// all the time, where moving the entity between archetypes would cost too much.
+//
+// 'dense' holds the entity handles and 'components' their data, both packed
+// with no holes. 'sparse' maps an entity index to its position in 'dense' and
+// is split into pages that are only allocated once an entity in their range
+// is added. add, remove and has are O(1), and removal swaps the last element
+// into the hole.
+
+#define SPARSE_SET_PAGE_SHIFT 12
+#define SPARSE_SET_PAGE_SIZE  (1 << SPARSE_SET_PAGE_SHIFT)
+
+lite_engine_sparse_set_t *lite_engine_sparse_set_create(size_t component_size) {
+	lite_engine_sparse_set_t *set = calloc(1, sizeof(*set));
+	set->component_size = component_size;
+
+	sparse_set_registry_t *r = &internal_sparse_sets;
+	if (r->count >= r->capacity) {
+		r->capacity = r->capacity * 2 + 8;
+		r->sets     = realloc(r->sets, sizeof(*r->sets) * r->capacity);
+	}
+	r->sets[r->count++] = set;
+
+	return set;
+}
+
+void lite_engine_sparse_set_free(lite_engine_sparse_set_t *set) {
+	sparse_set_registry_t *r = &internal_sparse_sets;
+	for (ui32 i = 0; i < r->count; i++) {
+		if (r->sets[i] == set) {
+			r->sets[i] = r->sets[--r->count];
+			break;
+		}
+	}
+
+	for (ui32 p = 0; p < set->page_count; p++) {
+		free(set->pages[p]);
+	}
+	free(set->pages);
+	free(set->dense);
+	free(set->components);
+	free(set);
+}
+
+static ui32 *internal_sparse_set_slot(const lite_engine_sparse_set_t *set, ui64 entity) {
+	ui32 index = lite_engine_entity_index(entity);
+	ui32 page  = index >> SPARSE_SET_PAGE_SHIFT;
+	if (page >= set->page_count || set->pages[page] == NULL) {
+		return NULL;
+	}
+	return &set->pages[page][index & (SPARSE_SET_PAGE_SIZE - 1)];
+}
+
+// returns the entity's component or NULL. the full handle is compared, so a
+// stale handle whose slot was reused does not match.
+void *lite_engine_sparse_set_get(const lite_engine_sparse_set_t *set, ui64 entity) {
+	ui32 *slot = internal_sparse_set_slot(set, entity);
+	if (slot == NULL || *slot >= set->count || set->dense[*slot] != entity) {
+		return NULL;
+	}
+	return set->components + set->component_size * *slot;
+}
+
+ui8 lite_engine_sparse_set_has(const lite_engine_sparse_set_t *set, ui64 entity) {
+	return lite_engine_sparse_set_get(set, entity) != NULL;
+}
+
+// adds or overwrites the entity's component. 'data' is copied in when it is
+// not NULL, otherwise the component is zeroed. the returned pointer is valid
+// until the next add or remove on this set.
+void *lite_engine_sparse_set_add(lite_engine_sparse_set_t *set, ui64 entity, const void *data) {
+	void *component = lite_engine_sparse_set_get(set, entity);
+
+	if (component == NULL) {
+		ui32 index = lite_engine_entity_index(entity);
+		ui32 page  = index >> SPARSE_SET_PAGE_SHIFT;
+
+		if (page >= set->page_count) {
+			set->pages = realloc(set->pages, sizeof(*set->pages) * (page + 1));
+			memset(set->pages + set->page_count, 0, sizeof(*set->pages) * (page + 1 - set->page_count));
+			set->page_count = page + 1;
+		}
+		if (set->pages[page] == NULL) { // zeroed, get and remove read slots never added
+			set->pages[page] = calloc(SPARSE_SET_PAGE_SIZE, sizeof(**set->pages));
+		}
+
+		if (set->count >= set->capacity) {
+			set->capacity   = set->capacity * 2 + 64;
+			set->dense      = realloc(set->dense,      sizeof(*set->dense) * set->capacity);
+			set->components = realloc(set->components, set->component_size * set->capacity);
+		}
+
+		set->pages[page][index & (SPARSE_SET_PAGE_SIZE - 1)] = set->count;
+		set->dense[set->count] = entity;
+		component = set->components + set->component_size * set->count;
+		set->count++;
+	}
+
+	if (data != NULL) {
+		memcpy(component, data, set->component_size);
+	} else {
+		memset(component, 0, set->component_size);
+	}
+	return component;
+}
+
+void lite_engine_sparse_set_remove(lite_engine_sparse_set_t *set, ui64 entity) {
+	ui32 *slot = internal_sparse_set_slot(set, entity);
+	if (slot == NULL || *slot >= set->count || set->dense[*slot] != entity) {
+		return;
+	}
+
+	ui32 position = *slot;
+	ui32 last     = --set->count;
+	if (position != last) {
+		set->dense[position] = set->dense[last];
+		memcpy(set->components + set->component_size * position,
+				set->components + set->component_size * last, set->component_size);
+		*internal_sparse_set_slot(set, set->dense[position]) = position;
+	}
+}
+
+// removes every entity from the set, keeping its memory.
+void lite_engine_sparse_set_clear(lite_engine_sparse_set_t *set) {
+	set->count = 0;
+}
+
+// starts a join over several sets. the smallest set drives the iteration and
+// every other set is probed, so the cost scales with the rarest component.
+lite_engine_sparse_set_join_t lite_engine_sparse_set_join(lite_engine_sparse_set_t **sets, ui32 set_count) {
+	assert(set_count > 0 && set_count <= LITE_ENGINE_SPARSE_SET_JOIN_MAX);
+
+	lite_engine_sparse_set_join_t join = {
+		.set_count = set_count,
+	};
+
+	ui32 driver = 0;
+	for (ui32 i = 0; i < set_count; i++) {
+		join.sets[i] = sets[i];
+		if (sets[i]->count < sets[driver]->count) {
+			driver = i;
+		}
+	}
+	join.driver = driver;
+	join.next   = sets[driver]->count;
+
+	return join;
+}
+
+// advances to the next entity present in every set of the join and fills
+// join->components with its component in each set, in the order the sets were
+// given. the driver is walked back to front, so removing the current entity
+// from any of the sets is safe while joining.
+ui8 lite_engine_sparse_set_join_next(lite_engine_sparse_set_join_t *join) {
+	const lite_engine_sparse_set_t *driver = join->sets[join->driver];
+
+	while (join->next > 0) {
+		join->next--;
+		if (join->next >= driver->count) { // entities were removed behind us
+			continue;
+		}
+
+		ui64 entity = driver->dense[join->next];
+		ui8  found  = 1;
+
+		for (ui32 i = 0; i < join->set_count; i++) {
+			if (i == join->driver) {
+				join->components[i] = driver->components + driver->component_size * join->next;
+				continue;
+			}
+			join->components[i] = lite_engine_sparse_set_get(join->sets[i], entity);
+			if (join->components[i] == NULL) {
+				found = 0;
+				break;
+			}
+		}
+
+		if (found) {
+			join->entity = entity;
+			return 1;
+		}
+	}
+
+	return 0;
 }
@@ -0,0 +1,267 @@
+#include "lite_engine.h"
+
+#include <pthread.h>
+#include <string.h>
+
+// structural changes recorded while systems run in parallel. every thread
+// records into its own buffer without locking. lite_engine_command_flush
+// merges all buffers, sorts the commands by entity and applies them in one
+// pass, so an entity that gets several components added or removed in a
+// frame is only moved between archetypes once.
+//
+// new entities come from lite_engine_entity_reserve, so their handles can be
+// used in later commands of the same frame before they exist.
+
+enum {
+	COMMAND_DESTROY,
+	COMMAND_ADD_COMPONENT,
+	COMMAND_REMOVE_COMPONENT,
+};
+
+typedef struct {
+	ui64 entity;
+	ui32 buffer;    // which thread recorded it, keeps the merge deterministic
+	ui32 sequence;  // order inside the recording buffer
+	ui32 type;
+	ui32 component;
+	ui32 payload;   // offset of the component data in the recording buffer
+} command_t;
+
+typedef struct {
+	command_t *commands;
+	ui32       count;
+	ui32       capacity;
+	ui8       *payloads;
+	ui32       payload_size;
+	ui32       payload_capacity;
+	ui32       id;
+} command_buffer_t;
+
+typedef struct {
+	command_buffer_t **buffers;
+	ui32               count;
+	ui32               capacity;
+	ui32               epoch;   // bumped by free_all so threads drop their stale buffers
+	pthread_mutex_t    mutex;
+
+	command_t         *merged;
+	ui32               merged_capacity;
+} command_registry_t;
+
+static command_registry_t internal_commands = {
+	.mutex = PTHREAD_MUTEX_INITIALIZER,
+	.epoch = 1,
+};
+
+static __thread command_buffer_t *internal_thread_buffer;
+static __thread ui32              internal_thread_buffer_epoch;
+
+static command_buffer_t *internal_command_buffer(void) {
+	command_registry_t *r = &internal_commands;
+
+	if (internal_thread_buffer != NULL &&
+			internal_thread_buffer_epoch == __atomic_load_n(&r->epoch, __ATOMIC_ACQUIRE)) {
+		return internal_thread_buffer;
+	}
+
+	command_buffer_t *buffer = calloc(1, sizeof(*buffer));
+
+	pthread_mutex_lock(&r->mutex);
+	if (r->count >= r->capacity) {
+		r->capacity = r->capacity * 2 + 8;
+		r->buffers  = realloc(r->buffers, sizeof(*r->buffers) * r->capacity);
+	}
+	buffer->id = r->count;
+	r->buffers[r->count++] = buffer;
+	internal_thread_buffer_epoch = r->epoch;
+	pthread_mutex_unlock(&r->mutex);
+
+	internal_thread_buffer = buffer;
+	return buffer;
+}
+
+static command_t *internal_command_push(ui64 entity, ui32 type, ui32 component) {
+	command_buffer_t *b = internal_command_buffer();
+
+	if (b->count >= b->capacity) {
+		b->capacity = b->capacity * 2 + 64;
+		b->commands = realloc(b->commands, sizeof(*b->commands) * b->capacity);
+	}
+
+	command_t *command = &b->commands[b->count];
+	*command = (command_t) {
+		.entity    = entity,
+		.buffer    = b->id,
+		.sequence  = b->count,
+		.type      = type,
+		.component = component,
+	};
+	b->count++;
+
+	return command;
+}
+
+// reserves a new entity. it is alive after the next flush, but its handle
+// can be given to the other lite_engine_command_* functions right away.
+ui64 lite_engine_command_create(void) {
+	return lite_engine_entity_reserve();
+}
+
+void lite_engine_command_destroy(ui64 entity) {
+	internal_command_push(entity, COMMAND_DESTROY, 0);
+}
+
+// records adding 'component' to 'entity'. 'data' is copied now, NULL adds a
+// zeroed component.
+void lite_engine_command_add_component(ui64 entity, lite_engine_component_t component, const void *data) {
+	command_t        *command = internal_command_push(entity, COMMAND_ADD_COMPONENT, component);
+	command_buffer_t *b       = internal_thread_buffer;
+	size_t            size    = lite_engine_component_get_size(component);
+
+	if (b->payload_size + size > b->payload_capacity) {
+		b->payload_capacity = (b->payload_size + size) * 2 + 1024;
+		b->payloads         = realloc(b->payloads, b->payload_capacity);
+	}
+
+	command->payload = b->payload_size;
+	if (data != NULL) {
+		memcpy(b->payloads + b->payload_size, data, size);
+	} else {
+		memset(b->payloads + b->payload_size, 0, size);
+	}
+	b->payload_size += (size + 15) & ~(size_t)15;
+}
+
+void lite_engine_command_remove_component(ui64 entity, lite_engine_component_t component) {
+	internal_command_push(entity, COMMAND_REMOVE_COMPONENT, component);
+}
+
+static int internal_command_compare(const void *a, const void *b) {
+	const command_t *x = a;
+	const command_t *y = b;
+
+	ui32 x_index = lite_engine_entity_index(x->entity);
+	ui32 y_index = lite_engine_entity_index(y->entity);
+	if (x_index != y_index) {
+		return x_index < y_index ? -1 : 1;
+	}
+	if (x->entity != y->entity) { // same slot, different generations
+		return x->entity < y->entity ? -1 : 1;
+	}
+	if (x->buffer != y->buffer) {
+		return x->buffer < y->buffer ? -1 : 1;
+	}
+	return x->sequence < y->sequence ? -1 : (x->sequence > y->sequence);
+}
+
+// applies every recorded command. call at a sync point, when no system is
+// running. reserved entities are made alive first.
+void lite_engine_command_flush(void) {
+	command_registry_t *r = &internal_commands;
+
+	lite_engine_entity_flush_reserved();
+
+	ui32 total = 0;
+	for (ui32 i = 0; i < r->count; i++) {
+		total += r->buffers[i]->count;
+	}
+	if (total == 0) {
+		return;
+	}
+
+	if (total > r->merged_capacity) {
+		r->merged_capacity = total * 2;
+		r->merged          = realloc(r->merged, sizeof(*r->merged) * r->merged_capacity);
+	}
+
+	ui32 merged = 0;
+	for (ui32 i = 0; i < r->count; i++) {
+		memcpy(r->merged + merged, r->buffers[i]->commands, sizeof(*r->merged) * r->buffers[i]->count);
+		merged += r->buffers[i]->count;
+	}
+
+	qsort(r->merged, merged, sizeof(*r->merged), internal_command_compare);
+
+	for (ui32 begin = 0; begin < merged;) {
+		ui64 entity = r->merged[begin].entity;
+		ui32 end    = begin;
+		while (end < merged && r->merged[end].entity == entity) {
+			end++;
+		}
+
+		if (!lite_engine_entity_is_alive(entity)) {
+			begin = end;
+			continue;
+		}
+
+		// fold the entity's commands into one archetype change
+		ui8  destroyed = 0;
+		ui64 add       = 0;
+		ui64 remove    = 0;
+		for (ui32 c = begin; c < end; c++) {
+			ui64 mask = LITE_ENGINE_COMPONENT_MASK(r->merged[c].component);
+			switch (r->merged[c].type) {
+				case COMMAND_DESTROY: {
+					destroyed = 1;
+				} break;
+				case COMMAND_ADD_COMPONENT: {
+					add    |=  mask;
+					remove &= ~mask;
+				} break;
+				case COMMAND_REMOVE_COMPONENT: {
+					remove |=  mask;
+					add    &= ~mask;
+				} break;
+			}
+		}
+
+		if (destroyed) {
+			lite_engine_entity_destroy(entity);
+			begin = end;
+			continue;
+		}
+
+		lite_engine_entity_change_components(entity, add, remove);
+
+		// the last value written for each component wins. written through the
+		// write accessor, an add over a component the entity already had
+		// moves nothing, so only this stamps the column as changed.
+		for (ui32 c = begin; c < end; c++) {
+			const command_t *command = &r->merged[c];
+			if (command->type != COMMAND_ADD_COMPONENT ||
+					(add & LITE_ENGINE_COMPONENT_MASK(command->component)) == 0) {
+				continue;
+			}
+			memcpy(lite_engine_entity_get_component_write(entity, command->component),
+					r->buffers[command->buffer]->payloads + command->payload,
+					lite_engine_component_get_size(command->component));
+		}
+
+		begin = end;
+	}
+
+	for (ui32 i = 0; i < r->count; i++) {
+		r->buffers[i]->count        = 0;
+		r->buffers[i]->payload_size = 0;
+	}
+}
+
+void lite_engine_command_free_all(void) {
+	command_registry_t *r = &internal_commands;
+
+	pthread_mutex_lock(&r->mutex);
+	for (ui32 i = 0; i < r->count; i++) {
+		free(r->buffers[i]->commands);
+		free(r->buffers[i]->payloads);
+		free(r->buffers[i]);
+	}
+	free(r->buffers);
+	free(r->merged);
+	r->buffers         = NULL;
+	r->count           = 0;
+	r->capacity        = 0;
+	r->merged          = NULL;
+	r->merged_capacity = 0;
+	__atomic_add_fetch(&r->epoch, 1, __ATOMIC_RELEASE);
+	pthread_mutex_unlock(&r->mutex);
+}
@@ -12,6 +12,7 @@
 DEFINE_LIST(GLuint)
 DEFINE_LIST(mesh_t)
 DEFINE_LIST(vertex_t)
+DEFINE_LIST(submesh_t)
 
 typedef struct {
 	GLFWwindow *window;
@@ -22,6 +23,8 @@ typedef struct {
 	ui16        window_position_y;
 	ui8         window_always_on_top;
 	ui8         window_fullscreen;
+	ui16        framebuffer_size_x; // written by the resize callback, drawn with as the viewport
+	ui16        framebuffer_size_y;
 } opengl_context_t;
 
 static opengl_context_t *internal_gl_context = NULL;
@@ -33,15 +36,148 @@ static ui16  internal_prefer_window_position_x    = 0;
 static ui16  internal_prefer_window_position_y    = 0;
 static ui8   internal_prefer_window_always_on_top = 0;
 static ui8   internal_prefer_window_fullscreen    = 0;
+static ui8   internal_prefer_render_thread        = 0;
+static ui8   internal_prefer_frame_latency        = 1;
 
-static const ui64 light  = 0;
-static const ui64 camera = 1;
-static const ui64 cube   = 2;
+static ui64 light  = LITE_ENGINE_ENTITY_NONE;
+static ui64 camera = LITE_ENGINE_ENTITY_NONE;
+static ui64 cube   = LITE_ENGINE_ENTITY_NONE;
 
 
 // object lists to keep stuff hot on the cache
-static ui64                  internal_gl_active_camera = 0;
-static object_pool_t         internal_object_pool;
+static ui64                  internal_gl_active_camera = LITE_ENGINE_ENTITY_NONE;
+static lite_engine_gl_components_t internal_gl_components;
+
+// transforms written at or after this change tick have not been snapshot yet
+static ui32 internal_gl_snapshot_query;
+static ui64 internal_gl_snapshot_since = 0;
+
+// the frame stages, each registered as a system in lite_engine_gl_start.
+// only input and submit call into GL or GLFW and stay on the main thread.
+// snapshot and simulation are fixed step stages, they run once per tick.
+
+// first of every tick: remembers where each transform was, so the frames
+// until the next tick can interpolate from there. only chunks written since
+// the last snapshot can have moved.
+static void internal_gl_snapshot_stage(void *data) {
+	(void)data;
+
+	lite_engine_query_iterator_t it = lite_engine_query_iterate_changed(internal_gl_snapshot_query,
+			LITE_ENGINE_COMPONENT_MASK(internal_gl_components.transform), internal_gl_snapshot_since);
+	internal_gl_snapshot_since = lite_engine_component_get_change_tick();
+
+	while (lite_engine_query_next(&it)) {
+		// not column_write, the snapshot is not a change the next one has to see
+		transform_t *transforms = lite_engine_query_column(&it, internal_gl_components.transform);
+		for (ui32 i = 0; i < it.count; i++) {
+			lite_engine_gl_transform_snapshot(&transforms[i]);
+		}
+	}
+}
+
+static void internal_gl_input_stage(void *data) {
+	(void)data;
+
+	glfwPollEvents();
+
+#if 1 // debugging input to exit
+	if (glfwGetKey(internal_gl_context->window, GLFW_KEY_ESCAPE))
+		lite_engine_stop();
+#endif
+
+	int window_size_x;
+	int window_size_y;
+	glfwGetWindowSize(internal_gl_context->window, &window_size_x, &window_size_y);
+
+	internal_gl_context->window_size_x = window_size_x;
+	internal_gl_context->window_size_y = window_size_y;
+
+	// waits here when the render thread is a full frame latency behind
+	if (lite_engine_gl_render_thread_is_running()) {
+		lite_engine_gl_render_queue_set_build_frame(lite_engine_gl_render_thread_acquire_slot());
+	}
+}
+
+static void internal_gl_simulation_stage(void *data) {
+	(void)data;
+
+	transform_t *cube_transform = lite_engine_entity_get_component_write(cube, internal_gl_components.transform);
+	lite_engine_gl_transform_set_rotation(cube_transform,
+			quaternion_multiply(
+				cube_transform->rotation,
+				quaternion_from_euler(vector3_up(lite_engine_get_tick_delta()))));
+}
+
+static void internal_gl_camera_stage(void *data) {
+	(void)data;
+
+	camera_t    *active_camera           =
+		lite_engine_entity_get_component_write(internal_gl_active_camera, internal_gl_components.camera);
+	transform_t *active_camera_transform =
+		lite_engine_entity_get_component(internal_gl_active_camera, internal_gl_components.transform);
+
+	float aspect = (float)internal_gl_context->window_size_x /
+		(float)internal_gl_context->window_size_y;
+	active_camera->projection =
+		matrix4_perspective(deg2rad(60), aspect, 0.0001f, 1000.0f);
+	active_camera->view =
+		lite_engine_gl_transform_view_matrix(active_camera_transform, lite_engine_get_interpolation_alpha());
+}
+
+static void internal_gl_transform_stage(void *data) {
+	(void)data;
+
+	lite_engine_gl_transform_stats_reset();
+	lite_engine_gl_transform_set_interpolation(lite_engine_get_interpolation_alpha());
+	lite_engine_gl_transform_hierarchy_update();
+	lite_engine_gl_mesh_gather();
+}
+
+static void internal_gl_cull_stage(void *data) {
+	(void)data;
+	lite_engine_gl_mesh_cull();
+}
+
+static void internal_gl_packet_stage(void *data) {
+	(void)data;
+	lite_engine_gl_mesh_build_packets();
+}
+
+// captures what the draw needs besides the packets, then draws right away
+// or hands the frame to the render thread.
+static void internal_gl_submit_stage(void *data) {
+	(void)data;
+
+	camera_t      *active_camera           =
+		lite_engine_entity_get_component(internal_gl_active_camera, internal_gl_components.camera);
+	transform_t   *active_camera_transform =
+		lite_engine_entity_get_component(internal_gl_active_camera, internal_gl_components.transform);
+	transform_t   *light_transform         =
+		lite_engine_entity_get_component(light, internal_gl_components.transform);
+	point_light_t *light_component         =
+		lite_engine_entity_get_component(light, internal_gl_components.light);
+
+	lite_engine_gl_frame_t frame = {
+		.view            = active_camera->view,
+		.projection      = active_camera->projection,
+		.camera_position = active_camera_transform->position,
+		.light_position  = light_transform->position,
+		.light           = *light_component,
+		.ambient         = vector3_one(0.4),
+		.viewport_x      = internal_gl_context->framebuffer_size_x,
+		.viewport_y      = internal_gl_context->framebuffer_size_y,
+	};
+
+	if (lite_engine_gl_render_thread_is_running()) {
+		lite_engine_gl_render_thread_publish(&frame);
+	} else {
+		lite_engine_gl_draw_frame(&frame, 0);
+	}
+}
+
+lite_engine_gl_components_t lite_engine_gl_get_components(void) {
+	return internal_gl_components;
+}
 
 ui64 lite_engine_gl_get_active_camera(void) {
 	return internal_gl_active_camera;
@@ -69,6 +205,19 @@ void lite_engine_gl_set_prefer_window_fullscreen(ui8 fullscreen) {
 	internal_prefer_window_fullscreen = fullscreen;
 }
 
+// submit GL from a dedicated thread while the next frame is simulated.
+// resources have to be created in lite_engine_gl_start, see
+// lite_engine_gl_render_thread.c.
+void lite_engine_gl_set_prefer_render_thread(ui8 render_thread) {
+	internal_prefer_render_thread = render_thread;
+}
+
+// how many frames the simulation may run ahead of the render thread.
+// 1 double buffers the render state, 2 triple buffers it.
+void lite_engine_gl_set_prefer_frame_latency(ui8 frame_latency) {
+	internal_prefer_frame_latency = frame_latency;
+}
+
 void APIENTRY glDebugOutput(const GLenum source, const GLenum type,
 		const unsigned int id, const GLenum severity,
 		const GLsizei length, const char *message,
@@ -164,7 +313,9 @@ void framebuffer_size_callback(
 		const int width,
 		const int height) {
 	(void)window;
-	glViewport(0, 0, width, height);
+	// applied by lite_engine_gl_draw_frame, which may run on the render thread
+	internal_gl_context->framebuffer_size_x = width;
+	internal_gl_context->framebuffer_size_y = height;
 }
 
 void key_callback(GLFWwindow *window, const int key, const int scancode,
@@ -235,6 +386,14 @@ void lite_engine_gl_start(void) {
 	glfwSetFramebufferSizeCallback(
 			internal_gl_context->window, 
 			framebuffer_size_callback);
+
+	{
+		int framebuffer_size_x;
+		int framebuffer_size_y;
+		glfwGetFramebufferSize(internal_gl_context->window, &framebuffer_size_x, &framebuffer_size_y);
+		internal_gl_context->framebuffer_size_x = framebuffer_size_x;
+		internal_gl_context->framebuffer_size_y = framebuffer_size_y;
+	}
 			
 	//glfwSetInputMode(internal_gl_context->window, 
 	//		GLFW_CURSOR, GLFW_CURSOR_DISABLED);
@@ -257,107 +416,167 @@ void lite_engine_gl_start(void) {
 				GL_DONT_CARE, 0, NULL, GL_TRUE);
 	}
 
-	glEnable(GL_CULL_FACE);
-	glEnable(GL_DEPTH_TEST);
+	lite_engine_gl_state_start();
 
-	glEnable(GL_BLEND);
+	lite_engine_gl_state_enable(GL_CULL_FACE);
+	lite_engine_gl_state_enable(GL_DEPTH_TEST);
+
+	lite_engine_gl_state_enable(GL_BLEND);
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
 	glClearColor(0.2, 0.3, 0.4, 1.0);
 
-	// allocate initial pool of objects
-	internal_object_pool = (object_pool_t) {
-		.materials  = calloc(sizeof(*internal_object_pool.materials),  1024),
-		.meshes     = calloc(sizeof(*internal_object_pool.meshes),     1024),
-		.transforms = calloc(sizeof(*internal_object_pool.transforms), 1024),
-		.lights     = calloc(sizeof(*internal_object_pool.lights),     1024),
-		.cameras    = calloc(sizeof(*internal_object_pool.cameras),    1024),
+	lite_engine_gl_uniform_buffer_start();
+
+	internal_gl_components = (lite_engine_gl_components_t) {
+		.transform = lite_engine_component_register(sizeof(transform_t)),
+		.mesh      = lite_engine_component_register(sizeof(mesh_t)),
+		.material  = lite_engine_component_register(sizeof(material_t)),
+		.material_slots = lite_engine_component_register(sizeof(material_slots_t)),
+		.light     = lite_engine_component_register(sizeof(point_light_t)),
+		.camera    = lite_engine_component_register(sizeof(camera_t)),
 	};
 
-	internal_object_pool.transforms[light] = (transform_t) {
+	lite_engine_gl_mesh_start();
+
+	{ // frame stages. the component masks order most of them, the explicit
+	  // dependencies cover the data they hand over outside of components
+		ui64 transform_mask = LITE_ENGINE_COMPONENT_MASK(internal_gl_components.transform);
+		ui64 mesh_mask      = LITE_ENGINE_COMPONENT_MASK(internal_gl_components.mesh);
+		ui64 material_mask  = LITE_ENGINE_COMPONENT_MASK(internal_gl_components.material) |
+		                      LITE_ENGINE_COMPONENT_MASK(internal_gl_components.material_slots);
+		ui64 light_mask     = LITE_ENGINE_COMPONENT_MASK(internal_gl_components.light);
+		ui64 camera_mask    = LITE_ENGINE_COMPONENT_MASK(internal_gl_components.camera);
+
+		internal_gl_snapshot_query = lite_engine_query_create(transform_mask, 0);
+
+		lite_engine_system_register("gl_snapshot", internal_gl_snapshot_stage, NULL,
+				transform_mask, transform_mask, LITE_ENGINE_SYSTEM_FIXED_STEP);
+		lite_engine_system_register("gl_simulation", internal_gl_simulation_stage, NULL,
+				transform_mask, transform_mask, LITE_ENGINE_SYSTEM_FIXED_STEP);
+
+		ui32 input      = lite_engine_system_register("gl_input", internal_gl_input_stage, NULL,
+				0, 0, LITE_ENGINE_SYSTEM_MAIN_THREAD);
+		// gl_transform only rebuilds the matrix caches inside transform_t,
+		// which the stages after it reach through the explicit dependencies
+		// below. it changes no position, rotation or scale, so it declares the
+		// transforms read. the camera, which reads those fields and none of the
+		// caches, then overlaps with it, while systems writing transforms still
+		// come before both
+		ui32 view       = lite_engine_system_register("gl_camera", internal_gl_camera_stage, NULL,
+				transform_mask | camera_mask, camera_mask, 0);
+		ui32 transforms = lite_engine_system_register("gl_transform", internal_gl_transform_stage, NULL,
+				transform_mask | mesh_mask | material_mask, 0, 0);
+		ui32 cull       = lite_engine_system_register("gl_cull", internal_gl_cull_stage, NULL,
+				transform_mask | mesh_mask | camera_mask, 0, 0);
+		ui32 packets    = lite_engine_system_register("gl_packets", internal_gl_packet_stage, NULL,
+				transform_mask | mesh_mask | material_mask, 0, 0);
+		ui32 submit     = lite_engine_system_register("gl_submit", internal_gl_submit_stage, NULL,
+				transform_mask | light_mask | camera_mask, 0, LITE_ENGINE_SYSTEM_MAIN_THREAD);
+
+		lite_engine_system_depend(view,    input);      // window size
+		lite_engine_system_depend(cull,    transforms); // gathered meshes
+		lite_engine_system_depend(packets, cull);       // visible list
+		lite_engine_system_depend(submit,  packets);    // render queue
+	}
+
+	light  = lite_engine_entity_create();
+	camera = lite_engine_entity_create();
+	cube   = lite_engine_entity_create();
+
+	lite_engine_entity_add_component(light, internal_gl_components.transform, &(transform_t) {
 		.position = { 0.0, 10, -10 },
 		.rotation = quaternion_identity(),
 		.scale    = vector3_one(1.0),
-	};
+	});
 
-	internal_object_pool.lights[light] = (point_light_t) {
+	lite_engine_entity_add_component(light, internal_gl_components.light, &(point_light_t) {
 		.diffuse   = vector3_one(0.8f),
 		.specular  = vector3_one(1.0f),
 		.constant  = 1.0f,
 		.linear    = 0.09f,
 		.quadratic = 0.0032f,
-	};
+	});
 
-	internal_object_pool.cameras[camera] = (camera_t) {
+	lite_engine_entity_add_component(camera, internal_gl_components.camera, &(camera_t) {
 		.projection = matrix4_identity(),
-	};
+		.view       = matrix4_identity(),
+	});
 
-	internal_object_pool.transforms[camera] = (transform_t) {
+	lite_engine_entity_add_component(camera, internal_gl_components.transform, &(transform_t) {
 		.position = (vector3_t){ 0.0, 0.0, -10.0 },
 		.rotation = quaternion_identity(),
 		.scale    = vector3_one(1.0),
 		.matrix   = matrix4_identity(),
-	};
+	});
 
 	lite_engine_gl_set_active_camera(camera);
 
 
-	internal_object_pool.materials[cube] = (material_t) {
+	lite_engine_entity_add_component(cube, internal_gl_components.material, &(material_t) {
 		.shader = lite_engine_gl_shader_create(
 				"res/shaders/phong_diffuse_vertex.glsl",
 				"res/shaders/phong_diffuse_fragment.glsl"),
+		.shader_instanced = lite_engine_gl_shader_create(
+				"res/shaders/phong_diffuse_instanced_vertex.glsl",
+				"res/shaders/phong_diffuse_fragment.glsl"),
 		.diffuseMap = lite_engine_gl_texture_create("res/textures/test.png"),
-	};
+	});
 
-	internal_object_pool.meshes[cube] = lite_engine_gl_mesh_lmod_alloc("res/models/cube.lmod");
-	internal_object_pool.meshes[cube].enabled = 1;
+	{
+		mesh_t cube_mesh  = lite_engine_gl_mesh_lmod_alloc("res/models/cube.lmod");
+		cube_mesh.enabled = 1;
+		lite_engine_entity_add_component(cube, internal_gl_components.mesh, &cube_mesh);
+	}
 
-	internal_object_pool.transforms[cube] = (transform_t) {
+	lite_engine_entity_add_component(cube, internal_gl_components.transform, &(transform_t) {
 		.position = vector3_zero(),
 		.rotation = quaternion_identity(),
 		.scale    = vector3_one(1.0),
-	};
+	});
+
+	// last, every GL resource has to exist before the context changes threads
+	if (internal_prefer_render_thread) {
+		lite_engine_gl_render_thread_start(internal_gl_context->window, internal_prefer_frame_latency);
+	}
 }
 
+// runs every frame stage in order on the calling thread, for use without
+// lite_engine_update, with one fixed step per frame. the stages normally run
+// as systems.
 void lite_engine_gl_render(void) {
-#if 1 // debugging input to exit
-	if (glfwGetKey(internal_gl_context->window, GLFW_KEY_ESCAPE))
-		lite_engine_stop();
-#endif
-
-	{ // projection
-		{
-			int window_size_x;
-			int window_size_y;
-			glfwGetWindowSize(
-					internal_gl_context->window, 
-					&window_size_x,
-					&window_size_y);
-
-			internal_gl_context->window_size_x = window_size_x;
-			internal_gl_context->window_size_y = window_size_y;
-		}
+	internal_gl_snapshot_stage(NULL);
+	internal_gl_simulation_stage(NULL);
+	internal_gl_input_stage(NULL);
+	internal_gl_camera_stage(NULL);
+	internal_gl_transform_stage(NULL);
+	internal_gl_cull_stage(NULL);
+	internal_gl_packet_stage(NULL);
+	internal_gl_submit_stage(NULL);
+}
 
-		float aspect = (float)internal_gl_context->window_size_x /
-			(float)internal_gl_context->window_size_y;
-		internal_object_pool.cameras[internal_gl_active_camera].projection =
-			matrix4_perspective(deg2rad(60), aspect, 0.0001f, 1000.0f);
-		internal_object_pool.transforms[internal_gl_active_camera].matrix = 
-			matrix4_identity();
-		lite_engine_gl_transform_calculate_view_matrix(
-				&internal_object_pool.transforms[internal_gl_active_camera]);
+// draws the render queue built into 'slot' with the uniforms in 'frame' and
+// presents it. needs the GL context, so it runs on the main thread or on the
+// render thread.
+void lite_engine_gl_draw_frame(const lite_engine_gl_frame_t *frame, ui32 slot) {
+	static ui16 viewport_x = 0;
+	static ui16 viewport_y = 0;
+	if (frame->viewport_x != viewport_x || frame->viewport_y != viewport_y) {
+		viewport_x = frame->viewport_x;
+		viewport_y = frame->viewport_y;
+		glViewport(0, 0, viewport_x, viewport_y);
 	}
 
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	lite_engine_gl_frame_t uniforms = *frame;
+	lite_engine_gl_uniform_buffer_update_frame(&uniforms.view, &uniforms.projection, uniforms.camera_position);
+	lite_engine_gl_uniform_buffer_update_lights(uniforms.light_position, &uniforms.light, uniforms.ambient);
 
-	lite_engine_gl_mesh_update(internal_object_pool);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-	internal_object_pool.transforms[cube].rotation = quaternion_multiply(
-			internal_object_pool.transforms[cube].rotation,
-			quaternion_from_euler(vector3_up(lite_engine_get_time_delta())));
+	lite_engine_gl_render_queue_set_submit_frame(slot);
+	lite_engine_gl_mesh_submit();
 
 	glfwSwapBuffers(internal_gl_context->window);
-	glfwPollEvents();
 }
 
 void lite_engine_gl_set_active_camera(ui64 camera) {
@@ -365,4 +584,11 @@ void lite_engine_gl_set_active_camera(ui64 camera) {
 }
 
 void lite_engine_gl_stop(void) {
+	lite_engine_gl_render_thread_stop();
+
+	lite_engine_gl_uniform_buffer_stop();
+	lite_engine_gl_transform_hierarchy_free();
+	lite_engine_gl_mesh_stop();
+	lite_engine_gl_render_queue_free();
+	lite_engine_gl_shader_stop();
 }
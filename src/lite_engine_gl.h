@@ -17,6 +17,10 @@ typedef struct {
 } point_light_t;
 DECLARE_LIST(point_light_t)
 
+typedef struct {
+	float          elements[9];
+} matrix3_t;
+
 typedef struct {
 	vector3_t      position;
 	vector2_t      texCoord;
@@ -24,55 +28,273 @@ typedef struct {
 } vertex_t;
 DECLARE_LIST(vertex_t)
 
+typedef GLint lite_engine_gl_shader_uniform_handle_t;
+
+// fixed uniform buffer binding points shared by every shader
+enum {
+	LITE_ENGINE_GL_UNIFORM_BUFFER_FRAME,
+	LITE_ENGINE_GL_UNIFORM_BUFFER_LIGHTS,
+	LITE_ENGINE_GL_UNIFORM_BUFFER_COUNT,
+};
+
+// a range of a mesh's shared vertex and index buffers, drawn as one piece
+// with the material in 'material_slot'. its indices count from base_vertex.
+typedef struct {
+	ui32           index_offset;
+	ui32           index_count;
+	ui32           base_vertex;
+	ui32           vertex_count;
+	ui32           material_slot;
+} submesh_t;
+DECLARE_LIST(submesh_t)
+
 typedef struct {
 	ui8            enabled;
 	ui8            use_wire_frame;
 	GLuint         VAO;
 	GLuint         VBO;
 	GLuint         EBO;
-	list_vertex_t  vertices;
+	GLuint         instance_VBO;
+	vector3_t      bounds_min;
+	vector3_t      bounds_max;
+	vector3_t      bounds_center;
+	float          bounds_radius;
+	ui32           vertex_count;
+	ui32           index_count;
+	GLenum         index_type;   // GL_UNSIGNED_SHORT when every index fits, else GL_UNSIGNED_INT
+	submesh_t     *submeshes;    // at least one, together they cover every index
+	ui32           submesh_count;
+	list_vertex_t  vertices;     // CPU copies, empty for binary meshes
 	list_GLuint    indices;
 } mesh_t;
 DECLARE_LIST(mesh_t)
 
+// the text file a binary mesh was cooked from, as it was when read. the
+// binary is only loaded while its source still matches exactly.
+typedef struct {
+	ui64           size;
+	ui64           mtime_seconds;
+	ui64           mtime_nanoseconds;
+} mesh_source_t;
+
+// the grid lite_engine_gl_mesh_weld rounds vertex components to when
+// importing a model. components in the same cell count as equal, see there
+#define LITE_ENGINE_GL_MESH_WELD_EPSILON 1e-5f
+
+// passes of lite_engine_gl_mesh_optimize, in the order they run
+enum {
+	LITE_ENGINE_GL_MESH_OPTIMIZE_VERTEX_CACHE = 1 << 0, // triangle order for the post-transform cache
+	LITE_ENGINE_GL_MESH_OPTIMIZE_OVERDRAW     = 1 << 1, // cluster order for less overdraw, needs VERTEX_CACHE
+	LITE_ENGINE_GL_MESH_OPTIMIZE_VERTEX_FETCH = 1 << 2, // vertex order for fetch locality
+	LITE_ENGINE_GL_MESH_OPTIMIZE_ALL          = (1 << 3) - 1,
+};
+
+// entries of the FIFO post-transform cache the overdraw pass and
+// lite_engine_gl_mesh_analyze_vertex_cache model
+#define LITE_ENGINE_GL_MESH_VERTEX_CACHE_SIZE 16
+
+// how much worse than the cache optimized order an overdraw cluster's
+// transformed vertices per triangle may get
+#define LITE_ENGINE_GL_MESH_OVERDRAW_THRESHOLD 1.05f
+
+typedef struct {
+	float          acmr;         // vertices transformed per triangle
+	float          atvr;         // vertices transformed per vertex
+} lite_engine_gl_mesh_cache_stats_t;
+
 typedef struct {
 	GLuint         shader;
+	GLuint         shader_instanced; // optional, 0 if the shader has no instanced variant
 	GLuint         diffuseMap;
 	GLuint         specularMap;
 } material_t;
 DECLARE_LIST(material_t)
 
+#define LITE_ENGINE_GL_MATERIAL_SLOTS_MAX 8
+
+// optional per submesh materials of an entity. a submesh whose
+// material_slot is not below 'count' uses the entity's material_t.
+typedef struct {
+	material_t     slots[LITE_ENGINE_GL_MATERIAL_SLOTS_MAX];
+	ui32           count;
+} material_slots_t;
+
+// matrix and normal_matrix are a cache of position, rotation and scale.
+// change those through the lite_engine_gl_transform_set_* functions, or call
+// lite_engine_gl_transform_mark_dirty after writing them directly, so the
+// cache gets rebuilt. for a transform with a parent (see
+// lite_engine_gl_transform_set_parent) the cache holds the world matrices.
+//
+// previous_* is the state at the start of the last fixed step, see
+// lite_engine_gl_transform_snapshot. the cache is built from previous_* and
+// position, rotation and scale blended by the interpolation alpha, so
+// rendering lags the simulation by less than one step but moves smoothly.
+// the gl_transform stage rebuilds the cache without declaring a transform
+// write, so frame systems should not read it, only the gl stages after it.
 typedef struct {
   matrix4_t        matrix;
+  matrix3_t        normal_matrix;
   vector3_t        position;
   quaternion_t     rotation;
   vector3_t        scale;
+  vector3_t        previous_position;
+  quaternion_t     previous_rotation;
+  vector3_t        previous_scale;
+  float            matrix_alpha;   // interpolation alpha the cache was built with
+  ui32             version;        // bumped on every change
+  ui8              matrix_valid;   // zero until the cache is built
+  ui8              previous_valid; // zero until the first snapshot
 } transform_t;
 DECLARE_LIST(transform_t)
 
 typedef struct {
 	matrix4_t      projection;
+	matrix4_t      view;         // from the camera's transform, rebuilt every frame
 	float          lastX;
 	float          lastY;
 } camera_t;
 DECLARE_LIST(camera_t)
 
+// smallest run of packets sharing a mesh and material that is drawn with
+// glDrawElementsInstanced instead of one glDrawElements per packet
+#define LITE_ENGINE_GL_INSTANCING_THRESHOLD 2
+
+enum {
+	LITE_ENGINE_GL_RENDER_PASS_OPAQUE,
+	LITE_ENGINE_GL_RENDER_PASS_WIRE_FRAME,
+};
+
+// per instance vertex attributes, see lite_engine_gl_mesh_alloc and
+// res/shaders/phong_diffuse_instanced_vertex.glsl
 typedef struct {
-	material_t    *materials;
-	mesh_t        *meshes;
-	transform_t   *transforms;
-	point_light_t *lights;
-	camera_t      *cameras;
-} object_pool_t;
+	matrix4_t      model_matrix;
+	matrix3_t      normal_matrix;
+} lite_engine_gl_instance_t;
+
+// everything needed to issue one draw, copied out of the object pool so the
+// render queue can sort and submit without touching entities again.
+typedef struct {
+	matrix4_t      model_matrix;
+	matrix3_t      normal_matrix;
+	GLuint         shader;
+	GLuint         shader_instanced;
+	GLuint         diffuseMap;
+	GLuint         specularMap;
+	GLuint         VAO;
+	GLuint         instance_VBO;
+	GLsizei        index_count;
+	GLenum         index_type;
+	ui32           index_offset;
+	GLint          base_vertex;
+	ui8            use_wire_frame;
+} lite_engine_gl_render_packet_t;
+
+// frames the simulation may run ahead of the render thread, and how many
+// copies of the render state that takes. 1 is double buffering, 2 triple.
+#define LITE_ENGINE_GL_FRAME_LATENCY_MAX 2
+#define LITE_ENGINE_GL_FRAMES_MAX        (LITE_ENGINE_GL_FRAME_LATENCY_MAX + 1)
+
+struct GLFWwindow;
+
+// per frame state the draw needs besides the render packets. captured at
+// the end of the simulation so the render thread never reads entities.
+typedef struct {
+	matrix4_t      view;
+	matrix4_t      projection;
+	vector3_t      camera_position;
+	vector3_t      light_position;
+	point_light_t  light;
+	vector3_t      ambient;
+	ui16           viewport_x;
+	ui16           viewport_y;
+} lite_engine_gl_frame_t;
+
+typedef struct {
+	ui64           packets;
+	ui64           draw_calls;
+	ui64           instanced_draw_calls;
+	ui64           instances;
+	ui64           state_changes;
+	ui64           state_changes_saved;
+} lite_engine_gl_render_queue_stats_t;
+
+typedef struct {
+	ui64           issued;
+	ui64           elided;
+} lite_engine_gl_state_stats_t;
+
+typedef struct {
+	ui64           recomputed;
+	ui64           reused;
+} lite_engine_gl_transform_stats_t;
+
+// structure of arrays input for lite_engine_gl_transform_batch_calculate_matrices
+typedef struct {
+	const float   *position_x;
+	const float   *position_y;
+	const float   *position_z;
+	const float   *rotation_w;
+	const float   *rotation_x;
+	const float   *rotation_y;
+	const float   *rotation_z;
+	const float   *scale_x;
+	const float   *scale_y;
+	const float   *scale_z;
+} lite_engine_gl_transform_soa_t;
+
+typedef struct {
+	ui64           tested;
+	ui64           visible;
+	ui64           culled;
+} lite_engine_gl_culling_stats_t;
+
+// ids of the GL component types, registered by lite_engine_gl_start
+typedef struct {
+	lite_engine_component_t transform;
+	lite_engine_component_t mesh;
+	lite_engine_component_t material;
+	lite_engine_component_t material_slots;
+	lite_engine_component_t light;
+	lite_engine_component_t camera;
+} lite_engine_gl_components_t;
 
 void      lite_engine_gl_start                           (void);
 void      lite_engine_gl_stop                            (void);
 void      lite_engine_gl_render                          (void);
+void      lite_engine_gl_draw_frame                      (const lite_engine_gl_frame_t *frame, ui32 slot);
+
+void      lite_engine_gl_render_thread_start             (struct GLFWwindow *window, ui32 frame_latency);
+void      lite_engine_gl_render_thread_stop              (void);
+ui8       lite_engine_gl_render_thread_is_running        (void);
+ui32      lite_engine_gl_render_thread_acquire_slot      (void);
+void      lite_engine_gl_render_thread_publish           (const lite_engine_gl_frame_t *frame);
 
 GLuint    lite_engine_gl_texture_create                  (const char *imageFile);
 
 void      lite_engine_gl_transform_calculate_matrix      (transform_t *t);
-void      lite_engine_gl_transform_calculate_view_matrix (transform_t *t);
+ui8       lite_engine_gl_transform_update                (transform_t *t);
+ui8       lite_engine_gl_transform_is_stale              (const transform_t *t);
+void      lite_engine_gl_transform_snapshot              (transform_t *t);
+void      lite_engine_gl_transform_set_interpolation     (float alpha);
+void      lite_engine_gl_transform_update_batch          (transform_t **transforms, size_t count);
+void      lite_engine_gl_transform_mark_dirty            (transform_t *t);
+void      lite_engine_gl_transform_set_position          (transform_t *t, vector3_t position);
+void      lite_engine_gl_transform_set_rotation          (transform_t *t, quaternion_t rotation);
+void      lite_engine_gl_transform_set_scale             (transform_t *t, vector3_t scale);
+void      lite_engine_gl_transform_set_parent            (ui64 child, ui64 parent);
+ui64      lite_engine_gl_transform_get_parent            (ui64 child);
+void      lite_engine_gl_transform_hierarchy_update      (void);
+void      lite_engine_gl_transform_hierarchy_free        (void);
+void      lite_engine_gl_transform_stats_reset           (void);
+lite_engine_gl_transform_stats_t
+          lite_engine_gl_transform_get_stats             (void);
+matrix4_t lite_engine_gl_transform_view_matrix          (const transform_t *t, float alpha);
+matrix3_t lite_engine_gl_transform_normal_matrix         (const matrix4_t *m);
+void      lite_engine_gl_transform_batch_calculate_matrices(const lite_engine_gl_transform_soa_t *soa,
+                                                          matrix4_t *matrices, size_t count);
+void      lite_engine_gl_transform_batch_use_kernel      (const char *name);
+const char *
+          lite_engine_gl_transform_batch_kernel_name     (void);
 vector3_t lite_engine_gl_transform_basis_forward         (transform_t t, float magnitude);
 vector3_t lite_engine_gl_transform_basis_up              (transform_t t, float magnitude);
 vector3_t lite_engine_gl_transform_basis_right           (transform_t t, float magnitude);
@@ -81,19 +303,99 @@ vector3_t lite_engine_gl_transform_basis_down            (transform_t t, float m
 vector3_t lite_engine_gl_transform_basis_left            (transform_t t, float magnitude);
 
 mesh_t    lite_engine_gl_mesh_alloc                      (list_vertex_t vertices, list_GLuint indices);
+mesh_t    lite_engine_gl_mesh_alloc_submeshes            (list_vertex_t vertices, list_GLuint indices,
+                                                          list_submesh_t submeshes);
+void      lite_engine_gl_mesh_upload                     (mesh_t *mesh, const vertex_t *vertices, ui32 vertex_count,
+                                                          const void *indices, GLenum index_type, ui32 index_count,
+                                                          const submesh_t *submeshes, ui32 submesh_count);
+ui32      lite_engine_gl_mesh_index_size                 (GLenum index_type);
+ui8       lite_engine_gl_mesh_weld                       (list_vertex_t *vertices, list_GLuint *indices,
+                                                          list_submesh_t *submeshes, float epsilon);
+ui8       lite_engine_gl_mesh_optimize                   (list_vertex_t *vertices, list_GLuint *indices,
+                                                          list_submesh_t *submeshes, ui32 flags);
+lite_engine_gl_mesh_cache_stats_t
+          lite_engine_gl_mesh_analyze_vertex_cache       (const list_GLuint *indices, const list_submesh_t *submeshes,
+                                                          ui32 vertex_count, ui32 cache_size);
 mesh_t    lite_engine_gl_mesh_lmod_alloc                 (const char* file_path);
+mesh_t    lite_engine_gl_mesh_lmod_parse                 (const char* file_path);
+ui8       lite_engine_gl_mesh_lmod_read                  (const char *text, size_t length, const char *name,
+                                                          list_vertex_t *vertices, list_GLuint *indices,
+                                                          list_submesh_t *submeshes);
+ui8       lite_engine_gl_mesh_source_stat                (const char *file_path, mesh_source_t *source);
+ui8       lite_engine_gl_mesh_binary_write               (const char *file_path, const mesh_source_t *source,
+                                                          const mesh_t *mesh);
+ui8       lite_engine_gl_mesh_binary_alloc               (const char *file_path, const mesh_source_t *source,
+                                                          mesh_t *mesh);
 void      lite_engine_gl_mesh_free                       (mesh_t *mesh);
-void      lite_engine_gl_mesh_update                     (object_pool_t object_pool);
+void      lite_engine_gl_mesh_start                      (void);
+void      lite_engine_gl_mesh_stop                       (void);
+void      lite_engine_gl_mesh_gather                     (void);
+void      lite_engine_gl_mesh_cull                       (void);
+void      lite_engine_gl_mesh_build_packets              (void);
+void      lite_engine_gl_mesh_submit                     (void);
+void      lite_engine_gl_mesh_update                     (void);
 
 GLuint    lite_engine_gl_shader_create                   (const char *vertex_shader_file_path,
                                                           const char *fragment_shader_file_path);
+void      lite_engine_gl_shader_stop                     (void);
 
 void      lite_engine_gl_shader_setUniformInt            (GLuint shader, const char *uniformName, GLuint i);
 void      lite_engine_gl_shader_setUniformFloat          (GLuint shader, const char *uniformName, GLfloat f);
 void      lite_engine_gl_shader_setUniformV3             (GLuint shader, const char *uniformName, vector3_t v);
 void      lite_engine_gl_shader_setUniformV4             (GLuint shader, const char *uniformName, vector4_t v);
+void      lite_engine_gl_shader_setUniformM3             (GLuint shader, const char *uniformName, matrix3_t *m);
 void      lite_engine_gl_shader_setUniformM4             (GLuint shader, const char *uniformName, matrix4_t *m);
 
+lite_engine_gl_shader_uniform_handle_t
+          lite_engine_gl_shader_get_uniform_handle       (GLuint shader, const char *uniformName);
+void      lite_engine_gl_shader_setUniformHandleInt      (lite_engine_gl_shader_uniform_handle_t handle, GLint i);
+void      lite_engine_gl_shader_setUniformHandleFloat    (lite_engine_gl_shader_uniform_handle_t handle, GLfloat f);
+void      lite_engine_gl_shader_setUniformHandleV3       (lite_engine_gl_shader_uniform_handle_t handle, vector3_t v);
+void      lite_engine_gl_shader_setUniformHandleV4       (lite_engine_gl_shader_uniform_handle_t handle, vector4_t v);
+void      lite_engine_gl_shader_setUniformHandleM3       (lite_engine_gl_shader_uniform_handle_t handle, matrix3_t *m);
+void      lite_engine_gl_shader_setUniformHandleM4       (lite_engine_gl_shader_uniform_handle_t handle, matrix4_t *m);
+
+void      lite_engine_gl_state_start                     (void);
+void      lite_engine_gl_state_enable                    (GLenum capability);
+void      lite_engine_gl_state_disable                   (GLenum capability);
+void      lite_engine_gl_state_use_program               (GLuint program);
+void      lite_engine_gl_state_polygon_mode              (GLenum mode);
+void      lite_engine_gl_state_bind_vertex_array         (GLuint VAO);
+void      lite_engine_gl_state_bind_buffer               (GLenum target, GLuint buffer);
+void      lite_engine_gl_state_bind_buffer_base          (GLenum target, GLuint index, GLuint buffer);
+void      lite_engine_gl_state_bind_texture              (GLuint unit, GLuint texture);
+lite_engine_gl_state_stats_t
+          lite_engine_gl_state_get_stats                 (void);
+
+void      lite_engine_gl_culling_begin                   (const matrix4_t *projection, const matrix4_t *view,
+                                                          ui32 count);
+void      lite_engine_gl_culling_set                     (ui32 index, const mesh_t *mesh, const matrix4_t *model);
+ui32      lite_engine_gl_culling_end                     (const ui32 **visible);
+lite_engine_gl_culling_stats_t
+          lite_engine_gl_culling_get_stats               (void);
+
+void      lite_engine_gl_render_queue_set_build_frame    (ui32 frame);
+void      lite_engine_gl_render_queue_set_submit_frame   (ui32 frame);
+void      lite_engine_gl_render_queue_begin              (vector3_t camera_position);
+void      lite_engine_gl_render_queue_push               (const lite_engine_gl_render_packet_t *packet);
+ui32      lite_engine_gl_render_queue_reserve            (ui32 count);
+void      lite_engine_gl_render_queue_set                (ui32 index, const lite_engine_gl_render_packet_t *packet);
+void      lite_engine_gl_render_queue_sort               (void);
+void      lite_engine_gl_render_queue_submit             (void);
+lite_engine_gl_render_queue_stats_t
+          lite_engine_gl_render_queue_get_stats          (void);
+void      lite_engine_gl_render_queue_free               (void);
+
+void      lite_engine_gl_uniform_buffer_start            (void);
+void      lite_engine_gl_uniform_buffer_stop             (void);
+void      lite_engine_gl_uniform_buffer_bind_program     (GLuint program);
+void      lite_engine_gl_uniform_buffer_update_frame     (matrix4_t *view, matrix4_t *projection,
+                                                          vector3_t camera_position);
+void      lite_engine_gl_uniform_buffer_update_lights    (vector3_t light_position, point_light_t *light,
+                                                          vector3_t ambient);
+
+lite_engine_gl_components_t
+          lite_engine_gl_get_components                  (void);
 ui64      lite_engine_gl_get_active_camera               (void);
 void      lite_engine_gl_set_active_camera               (ui64 camera);
 void      lite_engine_gl_set_prefer_window_title         (char *title);
@@ -107,5 +409,7 @@ void      lite_engine_gl_set_prefer_window_position_x    (ui16 pos_x);
 void      lite_engine_gl_set_prefer_window_position_y    (ui16 pos_y);
 void      lite_engine_gl_set_prefer_window_always_on_top (ui8 always_on_top);
 void      lite_engine_gl_set_prefer_window_fullscreen    (ui8 fullscreen);
+void      lite_engine_gl_set_prefer_render_thread        (ui8 render_thread);
+void      lite_engine_gl_set_prefer_frame_latency        (ui8 frame_latency);
 
 #endif
@@ -0,0 +1,260 @@
+#include "lite_engine_gl.h"
+
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// frustum culling. the bounding spheres of everything set in a frame are
+// kept as structure of arrays so four of them can be tested against a plane
+// at once. spheres that survive get a tighter test with their mesh's box.
+// filling the slots and testing them are both split across the job workers.
+// a slot is just a number to the caller, what it stands for is up to them.
+
+#define CULLING_BATCH 256
+
+typedef struct {
+	vector4_t planes[6]; // xyz normal pointing inwards, w distance
+} frustum_t;
+
+typedef struct {
+	frustum_t                   frustum;
+	ui32                        length;
+	ui32                        capacity;
+	float                      *x;
+	float                      *y;
+	float                      *z;
+	float                      *radius;
+	const mesh_t              **meshes;
+	const matrix4_t           **models;
+	ui32                       *scratch;       // slots that passed the sphere test, per batch
+	ui8                        *inside;
+	ui32                       *visible_slots; // slots that passed both tests, in order
+	lite_engine_gl_culling_stats_t stats;
+} culling_t;
+
+static culling_t internal_culling;
+
+// column major 'a' * 'b', the same product the vertex shader computes
+static matrix4_t internal_culling_multiply(const matrix4_t *a, const matrix4_t *b) {
+	matrix4_t m;
+	for (int column = 0; column < 4; column++) {
+		for (int row = 0; row < 4; row++) {
+			m.elements[column * 4 + row] =
+				a->elements[0 * 4 + row] * b->elements[column * 4 + 0] +
+				a->elements[1 * 4 + row] * b->elements[column * 4 + 1] +
+				a->elements[2 * 4 + row] * b->elements[column * 4 + 2] +
+				a->elements[3 * 4 + row] * b->elements[column * 4 + 3];
+		}
+	}
+	return m;
+}
+
+// Gribb & Hartmann. each plane is the sum or difference of the last row of
+// the clip matrix and one of the other rows.
+static frustum_t internal_culling_frustum(const matrix4_t *projection, const matrix4_t *view) {
+	matrix4_t    clip = internal_culling_multiply(projection, view);
+	const float *e    = clip.elements;
+
+	vector4_t rows[4];
+	for (int row = 0; row < 4; row++) {
+		rows[row] = (vector4_t){ e[row], e[4 + row], e[8 + row], e[12 + row] };
+	}
+
+	frustum_t f;
+	for (int i = 0; i < 3; i++) {
+		f.planes[i * 2 + 0] = vector4_add(rows[3], rows[i]);
+		f.planes[i * 2 + 1] = vector4_subtract(rows[3], rows[i]);
+	}
+
+	for (int i = 0; i < 6; i++) {
+		float length = sqrtf(
+				f.planes[i].x * f.planes[i].x +
+				f.planes[i].y * f.planes[i].y +
+				f.planes[i].z * f.planes[i].z);
+		f.planes[i].x /= length;
+		f.planes[i].y /= length;
+		f.planes[i].z /= length;
+		f.planes[i].w /= length;
+	}
+
+	return f;
+}
+
+// starts a frame's culling batch of 'count' slots, each to be filled with
+// lite_engine_gl_culling_set before lite_engine_gl_culling_end.
+void lite_engine_gl_culling_begin(const matrix4_t *projection, const matrix4_t *view, ui32 count) {
+	culling_t *c = &internal_culling;
+
+	c->frustum = internal_culling_frustum(projection, view);
+	c->length  = count;
+
+	if (count > c->capacity) {
+		c->capacity        = count * 2 + 64;
+		c->x               = realloc(c->x,               sizeof(*c->x)               * c->capacity);
+		c->y               = realloc(c->y,               sizeof(*c->y)               * c->capacity);
+		c->z               = realloc(c->z,               sizeof(*c->z)               * c->capacity);
+		c->radius          = realloc(c->radius,          sizeof(*c->radius)          * c->capacity);
+		c->meshes          = realloc(c->meshes,          sizeof(*c->meshes)          * c->capacity);
+		c->models          = realloc(c->models,          sizeof(*c->models)          * c->capacity);
+		c->scratch         = realloc(c->scratch,         sizeof(*c->scratch)         * c->capacity);
+		c->inside          = realloc(c->inside,          sizeof(*c->inside)          * c->capacity);
+		c->visible_slots   = realloc(c->visible_slots,   sizeof(*c->visible_slots)   * c->capacity);
+	}
+}
+
+// puts the mesh drawn with 'model' in slot 'index' of this frame's culling
+// batch. different slots may be set from different threads. 'mesh' and
+// 'model' must stay valid until lite_engine_gl_culling_end.
+void lite_engine_gl_culling_set(ui32 index, const mesh_t *mesh, const matrix4_t *model) {
+	culling_t *c = &internal_culling;
+
+	const float *m = model->elements;
+	vector3_t    b = mesh->bounds_center;
+
+	// the sphere grows with the largest axis scale of the model matrix
+	float scale_x = m[0] * m[0] + m[1] * m[1] + m[2]  * m[2];
+	float scale_y = m[4] * m[4] + m[5] * m[5] + m[6]  * m[6];
+	float scale_z = m[8] * m[8] + m[9] * m[9] + m[10] * m[10];
+	float scale   = sqrtf(fmaxf(scale_x, fmaxf(scale_y, scale_z)));
+
+	c->x[index]        = m[0] * b.x + m[4] * b.y + m[8]  * b.z + m[12];
+	c->y[index]        = m[1] * b.x + m[5] * b.y + m[9]  * b.z + m[13];
+	c->z[index]        = m[2] * b.x + m[6] * b.y + m[10] * b.z + m[14];
+	c->radius[index]   = mesh->bounds_radius * scale;
+	c->meshes[index]   = mesh;
+	c->models[index]   = model;
+}
+
+// writes the indices in [begin, end) of the spheres intersecting the
+// frustum to 'visible' and returns how many there are.
+static ui32 internal_culling_spheres(const culling_t *c, ui32 begin, ui32 end, ui32 *visible) {
+	ui32 count = 0;
+	ui32 i     = begin;
+
+#if defined(__SSE2__)
+	for (; i + 4 <= end; i += 4) {
+		__m128 x      = _mm_loadu_ps(&c->x[i]);
+		__m128 y      = _mm_loadu_ps(&c->y[i]);
+		__m128 z      = _mm_loadu_ps(&c->z[i]);
+		__m128 radius = _mm_loadu_ps(&c->radius[i]);
+		__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+
+		for (int p = 0; p < 6; p++) {
+			const vector4_t *plane = &c->frustum.planes[p];
+			__m128 distance = _mm_add_ps(
+					_mm_add_ps(
+						_mm_mul_ps(x, _mm_set1_ps(plane->x)),
+						_mm_mul_ps(y, _mm_set1_ps(plane->y))),
+					_mm_add_ps(
+						_mm_mul_ps(z, _mm_set1_ps(plane->z)),
+						_mm_set1_ps(plane->w)));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, _mm_sub_ps(_mm_setzero_ps(), radius)));
+		}
+
+		int mask = _mm_movemask_ps(inside);
+		for (int lane = 0; lane < 4; lane++) {
+			visible[count] = i + lane;
+			count += (mask >> lane) & 1;
+		}
+	}
+#endif
+
+	for (; i < end; i++) {
+		ui8 inside = 1;
+		for (int p = 0; p < 6; p++) {
+			const vector4_t *plane = &c->frustum.planes[p];
+			float distance =
+				c->x[i] * plane->x +
+				c->y[i] * plane->y +
+				c->z[i] * plane->z + plane->w;
+			inside &= distance >= -c->radius[i];
+		}
+		visible[count] = i;
+		count += inside;
+	}
+
+	return count;
+}
+
+// box test for a sphere that passed. the mesh's box is moved into world
+// space as a center and the projection of its half extents onto each plane.
+static ui8 internal_culling_box(const frustum_t *f, const mesh_t *mesh, const matrix4_t *model) {
+	const float *m = model->elements;
+
+	vector3_t center = vector3_scale(vector3_add(mesh->bounds_min, mesh->bounds_max), 0.5f);
+	vector3_t extent = vector3_scale(vector3_subtract(mesh->bounds_max, mesh->bounds_min), 0.5f);
+
+	vector3_t world_center = {
+		m[0] * center.x + m[4] * center.y + m[8]  * center.z + m[12],
+		m[1] * center.x + m[5] * center.y + m[9]  * center.z + m[13],
+		m[2] * center.x + m[6] * center.y + m[10] * center.z + m[14],
+	};
+
+	vector3_t world_extent = {
+		fabsf(m[0]) * extent.x + fabsf(m[4]) * extent.y + fabsf(m[8])  * extent.z,
+		fabsf(m[1]) * extent.x + fabsf(m[5]) * extent.y + fabsf(m[9])  * extent.z,
+		fabsf(m[2]) * extent.x + fabsf(m[6]) * extent.y + fabsf(m[10]) * extent.z,
+	};
+
+	for (int p = 0; p < 6; p++) {
+		const vector4_t *plane = &f->planes[p];
+		float distance =
+			world_center.x * plane->x +
+			world_center.y * plane->y +
+			world_center.z * plane->z + plane->w;
+		float radius =
+			world_extent.x * fabsf(plane->x) +
+			world_extent.y * fabsf(plane->y) +
+			world_extent.z * fabsf(plane->z);
+		if (distance < -radius) {
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+// tests the slots in [begin, end) and flags the visible ones in 'inside'.
+// each batch uses its own part of the scratch array.
+static void internal_culling_job(void *data, ui32 begin, ui32 end) {
+	culling_t *c       = data;
+	ui32      *scratch = c->scratch + begin;
+
+	memset(c->inside + begin, 0, end - begin);
+
+	ui32 spheres = internal_culling_spheres(c, begin, end, scratch);
+	for (ui32 i = 0; i < spheres; i++) {
+		ui32 index = scratch[i];
+		c->inside[index] = internal_culling_box(&c->frustum, c->meshes[index], c->models[index]);
+	}
+}
+
+// culls every slot set since lite_engine_gl_culling_begin. returns the
+// number of visible slots and points 'visible' at their indices, in order.
+// the list stays valid until the next lite_engine_gl_culling_begin.
+ui32 lite_engine_gl_culling_end(const ui32 **visible) {
+	culling_t *c = &internal_culling;
+
+	lite_engine_job_parallel_for(c->length, CULLING_BATCH, internal_culling_job, c);
+
+	ui32 count = 0;
+	for (ui32 i = 0; i < c->length; i++) {
+		c->visible_slots[count] = i;
+		count += c->inside[i];
+	}
+
+	c->stats = (lite_engine_gl_culling_stats_t) {
+		.tested  = c->length,
+		.visible = count,
+		.culled  = c->length - count,
+	};
+
+	*visible = c->visible_slots;
+	return count;
+}
+
+lite_engine_gl_culling_stats_t lite_engine_gl_culling_get_stats(void) {
+	return internal_culling.stats;
+}
@@ -1,119 +1,299 @@
 #include "lite_engine_gl.h"
 
-#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+
+// what one frame's mesh stages hand to each other. gather fills the arrays,
+// cull picks the visible ones, build_packets turns those into render packets
+// and submit draws them.
+typedef struct {
+	transform_t      **transforms;
+	mesh_t           **meshes;
+	material_t       **materials;
+	material_slots_t **material_slots; // NULL unless the mesh has submeshes and the entity slots
+	ui32          capacity;
+	ui32          count;
+
+	const ui32   *visible;        // gather indices of the meshes that passed culling
+	ui32          visible_count;
+	ui32         *packet_offsets; // of each visible mesh's first packet, from packet_first
+	ui32          packet_first;   // render queue slot of the frame's first packet
+} mesh_frame_t;
+
+// meshes per job in the cull and build_packets stages
+#define MESH_BATCH 256
+
+static ui32         internal_mesh_query;
+static mesh_frame_t internal_mesh_frame;
+
+// creates the query mesh_update walks. call after the GL components are registered.
+void lite_engine_gl_mesh_start(void) {
+	lite_engine_gl_components_t components = lite_engine_gl_get_components();
+
+	internal_mesh_query = lite_engine_query_create(
+			LITE_ENGINE_COMPONENT_MASK(components.transform) |
+			LITE_ENGINE_COMPONENT_MASK(components.mesh)      |
+			LITE_ENGINE_COMPONENT_MASK(components.material), 0);
+}
 
-void lite_engine_gl_mesh_update (object_pool_t object_pool) {
-	glEnable(GL_CULL_FACE);
+void lite_engine_gl_mesh_stop(void) {
+	mesh_frame_t *f = &internal_mesh_frame;
+	free(f->transforms);
+	free(f->meshes);
+	free(f->materials);
+	free(f->material_slots);
+	free(f->packet_offsets);
+	*f = (mesh_frame_t) {0};
+}
 
-	for (ui64 e = 0; e < 1024; e++) {
-		if (object_pool.meshes[e].enabled == 0) {
-			continue;
-		}
+// collects every entity with an enabled mesh and rebuilds the matrices of
+// the ones that moved.
+void lite_engine_gl_mesh_gather(void) {
+	mesh_frame_t               *f          = &internal_mesh_frame;
+	lite_engine_gl_components_t components = lite_engine_gl_get_components();
+
+	ui32 query_count = lite_engine_query_count(internal_mesh_query);
+	if (query_count > f->capacity) {
+		f->capacity   = query_count * 2;
+		f->transforms = realloc(f->transforms, sizeof(*f->transforms) * f->capacity);
+		f->meshes     = realloc(f->meshes,     sizeof(*f->meshes)     * f->capacity);
+		f->materials  = realloc(f->materials,  sizeof(*f->materials)  * f->capacity);
+		f->material_slots = realloc(f->material_slots, sizeof(*f->material_slots) * f->capacity);
+		f->packet_offsets = realloc(f->packet_offsets, sizeof(*f->packet_offsets) * f->capacity);
+	}
 
-		if (object_pool.meshes[e].use_wire_frame) {
-			glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-		} else {
-			glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+	f->count         = 0;
+	f->visible_count = 0;
+
+	lite_engine_query_iterator_t it = lite_engine_query_iterate(internal_mesh_query);
+	while (lite_engine_query_next(&it)) {
+		transform_t *chunk_transforms = lite_engine_query_column(&it, components.transform);
+		mesh_t      *chunk_meshes     = lite_engine_query_column(&it, components.mesh);
+		material_t  *chunk_materials  = lite_engine_query_column(&it, components.material);
+
+		for (ui32 i = 0; i < it.count; i++) {
+			if (chunk_meshes[i].enabled == 0) {
+				continue;
+			}
+			f->transforms[f->count]     = &chunk_transforms[i];
+			f->meshes[f->count]         = &chunk_meshes[i];
+			f->materials[f->count]      = &chunk_materials[i];
+			f->material_slots[f->count] = chunk_meshes[i].submesh_count > 1 ?
+				lite_engine_entity_get_component(it.entities[i], components.material_slots) : NULL;
+			f->count++;
 		}
+	}
+
+	lite_engine_gl_transform_update_batch(f->transforms, f->count);
+}
+
+// the culling slot of each mesh is its gather index, packets are built from it
+static void internal_mesh_cull_job(void *data, ui32 begin, ui32 end) {
+	mesh_frame_t *f = data;
+	for (ui32 i = begin; i < end; i++) {
+		lite_engine_gl_culling_set(i, f->meshes[i], &f->transforms[i]->matrix);
+	}
+}
 
-		{ // draw
-			glUseProgram(object_pool.materials[e].shader);
-
-			// model matrix uniform
-			lite_engine_gl_transform_calculate_matrix(&object_pool.transforms[e]);
-
-			lite_engine_gl_shader_setUniformM4(object_pool.materials[e].shader, "u_modelMatrix", 
-					&object_pool.transforms[e].matrix);
-
-			// view matrix uniform
-			lite_engine_gl_shader_setUniformM4(object_pool.materials[e].shader, "u_viewMatrix",
-					&object_pool.transforms[lite_engine_gl_get_active_camera()].matrix);
-
-			// projection matrix uniform
-			lite_engine_gl_shader_setUniformM4(object_pool.materials[e].shader, "u_projectionMatrix",
-					&object_pool.cameras[lite_engine_gl_get_active_camera()].projection);
-
-			// camera position uniform
-			lite_engine_gl_shader_setUniformV3(object_pool.materials[e].shader, "u_cameraPos",
-					object_pool.transforms[lite_engine_gl_get_active_camera()].position);
-
-#if 1
-			const int light = 0;
-			// light uniforms
-			lite_engine_gl_shader_setUniformV3(
-					object_pool.materials[e].shader,
-					"u_light.position",
-					object_pool.transforms[light].position);
-
-			lite_engine_gl_shader_setUniformFloat(
-					object_pool.materials[e].shader,
-					"u_light.constant",
-					object_pool.lights[light].constant);
-
-			lite_engine_gl_shader_setUniformFloat(
-					object_pool.materials[e].shader,
-					"u_light.linear",
-					object_pool.lights[light].linear);
-
-			lite_engine_gl_shader_setUniformFloat(
-					object_pool.materials[e].shader,
-					"u_light.quadratic",
-					object_pool.lights[light].quadratic);
-
-			lite_engine_gl_shader_setUniformV3(
-					object_pool.materials[e].shader,
-					"u_light.diffuse",
-					object_pool.lights[light].diffuse);
-
-			lite_engine_gl_shader_setUniformV3(
-					object_pool.materials[e].shader,
-					"u_light.specular",
-					object_pool.lights[light].specular);
-#endif
-
-			// textures
-			glActiveTexture(GL_TEXTURE0);
-			glBindTexture(GL_TEXTURE_2D, object_pool.materials[e].diffuseMap);
-
-			glActiveTexture(GL_TEXTURE1);
-			glBindTexture(GL_TEXTURE_2D, object_pool.materials[e].specularMap);
-
-			// other material properties
-			lite_engine_gl_shader_setUniformInt   (object_pool.materials[e].shader, "u_material.diffuse",   0);
-			lite_engine_gl_shader_setUniformInt   (object_pool.materials[e].shader, "u_material.specular",  1);
-			lite_engine_gl_shader_setUniformFloat (object_pool.materials[e].shader, "u_material.shininess", 32.0f);
-			lite_engine_gl_shader_setUniformV3    (object_pool.materials[e].shader, "u_ambientLight",
-					vector3_one(0.4));
-
-			// draw
-			glBindVertexArray(object_pool.meshes[e].VAO);
-			glDrawElements( GL_TRIANGLES, object_pool.meshes[e].indices.length, GL_UNSIGNED_INT, 0);
+// culls the gathered meshes against the active camera.
+void lite_engine_gl_mesh_cull(void) {
+	mesh_frame_t               *f          = &internal_mesh_frame;
+	lite_engine_gl_components_t components = lite_engine_gl_get_components();
+
+	ui64      camera           = lite_engine_gl_get_active_camera();
+	camera_t *camera_component = lite_engine_entity_get_component(camera, components.camera);
+
+	lite_engine_gl_culling_begin(&camera_component->projection, &camera_component->view, f->count);
+	lite_engine_job_parallel_for(f->count, MESH_BATCH, internal_mesh_cull_job, f);
+
+	f->visible_count = lite_engine_gl_culling_end(&f->visible);
+}
+
+static void internal_mesh_packet_job(void *data, ui32 begin, ui32 end) {
+	mesh_frame_t *f = data;
+
+	for (ui32 v = begin; v < end; v++) {
+		ui32              i         = f->visible[v];
+		mesh_t           *mesh      = f->meshes[i];
+		transform_t      *transform = f->transforms[i];
+		material_slots_t *slots     = f->material_slots[i];
+
+		for (ui32 s = 0; s < mesh->submesh_count; s++) {
+			const submesh_t *submesh  = &mesh->submeshes[s];
+			const material_t *material = slots != NULL && submesh->material_slot < slots->count ?
+				&slots->slots[submesh->material_slot] : f->materials[i];
+
+			lite_engine_gl_render_packet_t packet = {
+				.model_matrix     = transform->matrix,
+				.normal_matrix    = transform->normal_matrix,
+				.shader           = material->shader,
+				.shader_instanced = material->shader_instanced,
+				.diffuseMap       = material->diffuseMap,
+				.specularMap      = material->specularMap,
+				.VAO              = mesh->VAO,
+				.instance_VBO     = mesh->instance_VBO,
+				.index_count      = submesh->index_count,
+				.index_type       = mesh->index_type,
+				.index_offset     = submesh->index_offset,
+				.base_vertex      = submesh->base_vertex,
+				.use_wire_frame   = mesh->use_wire_frame,
+			};
+			lite_engine_gl_render_queue_set(f->packet_first + f->packet_offsets[v] + s, &packet);
 		}
 	}
+}
+
+// builds a render packet for every submesh of every visible mesh and sorts
+// them so that GL state is only changed when it has to be. the slots of
+// each mesh's packets are handed out up front, so the packets are built in
+// parallel and land in the same order every frame.
+void lite_engine_gl_mesh_build_packets(void) {
+	mesh_frame_t               *f          = &internal_mesh_frame;
+	lite_engine_gl_components_t components = lite_engine_gl_get_components();
+
+	ui64         camera           = lite_engine_gl_get_active_camera();
+	transform_t *camera_transform = lite_engine_entity_get_component(camera, components.transform);
+
+	lite_engine_gl_render_queue_begin(camera_transform->position);
+
+	ui32 packet_count = 0;
+	for (ui32 v = 0; v < f->visible_count; v++) {
+		f->packet_offsets[v] = packet_count;
+		packet_count        += f->meshes[f->visible[v]]->submesh_count;
+	}
+
+	f->packet_first = lite_engine_gl_render_queue_reserve(packet_count);
+	lite_engine_job_parallel_for(f->visible_count, MESH_BATCH, internal_mesh_packet_job, f);
 
-	glUseProgram(0);
+	lite_engine_gl_render_queue_sort();
 }
 
+// draws the sorted packets. the only mesh stage that touches GL.
+void lite_engine_gl_mesh_submit(void) {
+	lite_engine_gl_state_enable(GL_CULL_FACE);
+	lite_engine_gl_render_queue_submit();
+	lite_engine_gl_state_use_program(0);
+}
+
+// every mesh stage in order, for callers that do not run the frame graph.
+void lite_engine_gl_mesh_update(void) {
+	lite_engine_gl_mesh_gather();
+	lite_engine_gl_mesh_cull();
+	lite_engine_gl_mesh_build_packets();
+	lite_engine_gl_mesh_submit();
+}
+
+// creates a mesh from 'vertices' and 'indices' and takes ownership of the
+// lists. they stay around as the mesh's CPU copies.
 mesh_t lite_engine_gl_mesh_alloc(list_vertex_t vertices, list_GLuint indices) {
+	return lite_engine_gl_mesh_alloc_submeshes(vertices, indices, (list_submesh_t) {0});
+}
+
+// lite_engine_gl_mesh_alloc for a mesh made of the ranges in 'submeshes',
+// which all share one vertex and one index buffer. the mesh keeps its own
+// copy of the ranges, 'submeshes' is freed. an empty list means one range
+// over everything.
+mesh_t lite_engine_gl_mesh_alloc_submeshes(list_vertex_t vertices, list_GLuint indices,
+		list_submesh_t submeshes) {
 	mesh_t m   = {0};
 	m.enabled  = 1;
 	m.vertices = vertices;
 	m.indices  = indices;
 
-	glGenVertexArrays(1, &m.VAO);
-	glGenBuffers(1, &m.VBO);
-	glGenBuffers(1, &m.EBO);
+	{ // bounds
+		if (vertices.length > 0) {
+			m.bounds_min = vertices.array[0].position;
+			m.bounds_max = vertices.array[0].position;
+		}
+		for (size_t i = 1; i < vertices.length; i++) {
+			m.bounds_min = vector3_min(m.bounds_min, vertices.array[i].position);
+			m.bounds_max = vector3_max(m.bounds_max, vertices.array[i].position);
+		}
 
-	glBindVertexArray(m.VAO);
+		m.bounds_center = vector3_scale(vector3_add(m.bounds_min, m.bounds_max), 0.5f);
 
-	glBindBuffer(GL_ARRAY_BUFFER, m.VBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(vertex_t) * vertices.length, vertices.array,
-			GL_STATIC_DRAW);
+		float radius_squared = 0.0f;
+		for (size_t i = 0; i < vertices.length; i++) {
+			radius_squared = fmaxf(radius_squared,
+					vector3_square_distance(m.bounds_center, vertices.array[i].position));
+		}
+		m.bounds_radius = sqrtf(radius_squared);
+	}
+
+	lite_engine_gl_mesh_upload(&m, vertices.array, vertices.length,
+			indices.array, GL_UNSIGNED_INT, indices.length, submeshes.array, submeshes.length);
+	free(submeshes.array);
+
+	return m;
+}
+
+// bytes per index of 'index_type'
+ui32 lite_engine_gl_mesh_index_size(GLenum index_type) {
+	return index_type == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+}
+
+// 0xffff is left out, it is the primitive restart index of 16 bit indices
+static ui8 internal_mesh_indices_fit_short(const GLuint *indices, ui32 index_count) {
+	GLuint largest = 0;
+	for (ui32 i = 0; i < index_count; i++) {
+		largest = indices[i] > largest ? indices[i] : largest;
+	}
+	return largest < 0xffff;
+}
+
+// creates the GL objects of 'm' and fills its vertex and index buffers from
+// the given arrays, which may be freed or unmapped afterwards. 'indices' are
+// GL_UNSIGNED_INT or GL_UNSIGNED_SHORT as 'index_type' says. 32 bit indices
+// that all fit in 16 bits are narrowed, which halves the index buffer and
+// the index reads of every draw. 'submeshes' is copied, with none the whole
+// mesh is one submesh.
+void lite_engine_gl_mesh_upload(mesh_t *m, const vertex_t *vertices, ui32 vertex_count,
+		const void *indices, GLenum index_type, ui32 index_count,
+		const submesh_t *submeshes, ui32 submesh_count) {
+	GLushort *narrowed = NULL;
+	if (index_type == GL_UNSIGNED_INT && internal_mesh_indices_fit_short(indices, index_count)) {
+		const GLuint *wide = indices;
+		narrowed = malloc(sizeof(*narrowed) * index_count);
+		for (ui32 i = 0; i < index_count; i++) {
+			narrowed[i] = (GLushort)wide[i];
+		}
+		indices    = narrowed;
+		index_type = GL_UNSIGNED_SHORT;
+	}
+
+	m->vertex_count = vertex_count;
+	m->index_count  = index_count;
+	m->index_type   = index_type;
+
+	if (submesh_count > 0) {
+		m->submesh_count = submesh_count;
+		m->submeshes     = malloc(sizeof(*m->submeshes) * submesh_count);
+		memcpy(m->submeshes, submeshes, sizeof(*m->submeshes) * submesh_count);
+	} else {
+		m->submesh_count = 1;
+		m->submeshes     = malloc(sizeof(*m->submeshes));
+		m->submeshes[0]  = (submesh_t) {
+			.index_count  = index_count,
+			.vertex_count = vertex_count,
+		};
+	}
 
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m.EBO);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * indices.length, indices.array,
+	glGenVertexArrays(1, &m->VAO);
+	glGenBuffers(1, &m->VBO);
+	glGenBuffers(1, &m->EBO);
+	glGenBuffers(1, &m->instance_VBO);
+
+	lite_engine_gl_state_bind_vertex_array(m->VAO);
+
+	lite_engine_gl_state_bind_buffer(GL_ARRAY_BUFFER, m->VBO);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(vertex_t) * vertex_count, vertices,
 			GL_STATIC_DRAW);
 
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m->EBO);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, lite_engine_gl_mesh_index_size(index_type) * index_count,
+			indices, GL_STATIC_DRAW);
+	free(narrowed);
+
 	GLuint vertStride = sizeof(vertex_t); // how many bytes per vertex?
 
 	// position attribute
@@ -131,13 +311,64 @@ mesh_t lite_engine_gl_mesh_alloc(list_vertex_t vertices, list_GLuint indices) {
 			(void *)offsetof(vertex_t, normal));
 	glEnableVertexAttribArray(2);
 
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glBindVertexArray(0);
+	// per instance attributes. the buffer is filled by the render queue for
+	// every run of packets sharing this mesh and material.
+	lite_engine_gl_state_bind_buffer(GL_ARRAY_BUFFER, m->instance_VBO);
 
-	return m;
+	GLuint instanceStride = sizeof(lite_engine_gl_instance_t);
+
+	// model matrix attribute, one location per column
+	for (GLuint column = 0; column < 4; column++) {
+		GLuint location = 3 + column;
+		glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, instanceStride,
+				(void *)(offsetof(lite_engine_gl_instance_t, model_matrix) +
+				sizeof(float) * 4 * column));
+		glEnableVertexAttribArray(location);
+		glVertexAttribDivisor(location, 1);
+	}
+
+	// normal matrix attribute, one location per column
+	for (GLuint column = 0; column < 3; column++) {
+		GLuint location = 7 + column;
+		glVertexAttribPointer(location, 3, GL_FLOAT, GL_FALSE, instanceStride,
+				(void *)(offsetof(lite_engine_gl_instance_t, normal_matrix) +
+				sizeof(float) * 3 * column));
+		glEnableVertexAttribArray(location);
+		glVertexAttribDivisor(location, 1);
+	}
+
+	lite_engine_gl_state_bind_buffer(GL_ARRAY_BUFFER, 0);
+	lite_engine_gl_state_bind_vertex_array(0);
 }
 
+// loads a text .lmod file. the first load cooks it into a binary .lmodb
+// next to it (see lite_engine_gl_mesh_binary.c), later loads map that
+// instead for as long as the text file has not changed since.
 mesh_t lite_engine_gl_mesh_lmod_alloc(const char* file_path) {
+	char binary_path[4096];
+	snprintf(binary_path, sizeof(binary_path), "%sb", file_path);
+
+	// stat'ed before parsing, so an edit made while cooking leaves the
+	// binary stale instead of looking fresh
+	mesh_source_t source;
+	ui8           has_source = lite_engine_gl_mesh_source_stat(file_path, &source);
+	if (has_source) {
+		mesh_t mesh;
+		if (lite_engine_gl_mesh_binary_alloc(binary_path, &source, &mesh)) {
+			debug_log("Loaded binary mesh '%s'", binary_path);
+			return mesh;
+		}
+	}
+
+	mesh_t mesh = lite_engine_gl_mesh_lmod_parse(file_path);
+	if (has_source) {
+		lite_engine_gl_mesh_binary_write(binary_path, &source, &mesh);
+	}
+	return mesh;
+}
+
+// parses a text .lmod file, ignoring any binary version of it.
+mesh_t lite_engine_gl_mesh_lmod_parse(const char* file_path) {
 	debug_log("Loading lmod file from '%s'", file_path);
 	file_buffer fb = file_buffer_alloc(file_path);
 
@@ -148,138 +379,55 @@ mesh_t lite_engine_gl_mesh_lmod_alloc(const char* file_path) {
 		assert(0);
 	}
 
-	list_vector3_t positions  = list_vector3_t_alloc();
-	list_vector3_t normals    = list_vector3_t_alloc();
-	list_vector2_t tex_coords = list_vector2_t_alloc();
-	list_GLuint indices       = list_GLuint_alloc();
-
-	enum {
-		STATE_INITIAL = -1,
-		STATE_POSITION,
-		STATE_INDICES,
-		STATE_NORMAL,
-		STATE_TEX_COORD,
-	};
-	uint8_t state = STATE_INITIAL;
-
-	for(char *c = fb.text; c < fb.text+fb.length; c++) {
-
-		if (isspace(*c)) {
-			continue;
-		} else if (*c == '#') {
-			while(*c != '\n' && *c != '\0') { c++; }
-			continue;
-		}
-
-		char token[128];
-		{
-			int num_tokens = sscanf(c, "%s", token);
-			if (num_tokens != 1) {
-				debug_error("Failed to read token at '%s'", file_path);
-				assert(0);
-			}
-		}
-
-		// TODO The order in which a buffer is loaded from the lmod file matters.
-		// need to change the importer so that it can handle parsing the buffers
-		// in any order.
-
-		if (strcmp(token, "vertex_indices:") == 0 || state == STATE_INDICES) {
-			if (state != STATE_INDICES)
-				c += sizeof("vertex_indices:");
-
-			state = STATE_INDICES;
-
-			GLuint index;
-			int num_tokens = sscanf(c, "%u", &index);
-			if (num_tokens != 1) {
-				debug_error("Failed to read vertex_indices at '%s'", file_path);
-				assert(0);
-			}
-			while(*c != ' ' && *c != '\0') { c++; } // skip the rest of the number
+	list_vertex_t  vertices  = list_vertex_t_alloc();
+	list_GLuint    indices   = list_GLuint_alloc();
+	list_submesh_t submeshes = list_submesh_t_alloc();
 
-			//debug_log("%u ", index);
-			list_GLuint_add(&indices, index);
-		}
-
-		if (strcmp(token, "vertex_texture_coordinates:") == 0 || state == STATE_TEX_COORD) {
-			if (state != STATE_TEX_COORD)
-				c += sizeof("vertex_texture_coordinates:");
-
-			state = STATE_TEX_COORD;
-
-			vector2_t tex_coord = {0};
-			int num_tokens = sscanf(c, "%f %f", &tex_coord.x, &tex_coord.y);
-			if (num_tokens != 2) {
-				debug_error("Failed to read vertex_texture_coordinates at '%s'", file_path);
-				assert(0);
-			}
-
-			list_vector2_t_add(&tex_coords, tex_coord);
-			//vector2_print(tex_coords.array[tex_coords.length-1], "tex coord");
-			while (*c != '\n' && *c != '\0') { c++; } 
-		}
-
-		if (strcmp(token, "vertex_normals:") == 0 || state == STATE_NORMAL) {
-			if (state != STATE_NORMAL)
-				c += sizeof("vertex_normals:");
-
-			state = STATE_NORMAL;
-
-			vector3_t normal = {0};
-			int num_tokens = sscanf(c, "%f %f %f", &normal.x, &normal.y, &normal.z);
-			if (num_tokens != 3) {
-				debug_error("Failed to read vertex_normals at '%s'", file_path);
-				assert(0);
-			}
-
-			//vector3_print(normal, "normal");
-			list_vector3_t_add(&normals, normal);
-			while (*c != '\n' && *c != '\0') { c++; } 
-		}
-
-		if (strcmp(token, "vertex_positions:") == 0 || state == STATE_POSITION) {
-			if (state != STATE_POSITION)
-				c += sizeof("vertex_positions:");
-
-			state = STATE_POSITION;
-
-			vector3_t position = {0};
-			int num_tokens = sscanf(c, "%f %f %f", &position.x, &position.y, &position.z);
-			if (num_tokens != 3) {
-				debug_error("Failed to read vertex_positions at '%s'", file_path);
-				assert(0);
-			}
-
-			//vector3_print(position, "position");
-			list_vector3_t_add(&positions, position);
-			while (*c != '\n' && *c != '\0') { c++; } 
-		}
+	if (!lite_engine_gl_mesh_lmod_read(fb.text, fb.length, file_path, &vertices, &indices, &submeshes)) {
+		assert(0);
 	}
 
 	file_buffer_free(fb);
 
-	list_vertex_t vertices = list_vertex_t_alloc();
-	for(size_t i = 0; i < positions.length; i++) {
-		vertex_t vertex = {0};
-		if (positions.length > 0)
-		vertex.position = positions.array[i];
-		if (normals.length > 0)
-		vertex.normal   = normals.array[i];
-		if (tex_coords.length > 0)
-		vertex.texCoord = tex_coords.array[i];
-		list_vertex_t_add(&vertices, vertex);
+	// the exporter splits every edge, so most vertices are copies of their
+	// neighbours in other triangles. the reader already rejected indices out
+	// of bounds, welding checks the ranges again and a mesh failing that
+	// would make GL read past its buffers, so it is an error like bad text.
+	size_t read_vertices = vertices.length;
+	if (!lite_engine_gl_mesh_weld(&vertices, &indices, &submeshes, LITE_ENGINE_GL_MESH_WELD_EPSILON)) {
+		debug_error("Failed to weld '%s'", file_path);
+		assert(0);
 	}
 
-	list_vector3_t_free(&positions);
-	list_vector3_t_free(&normals);
-	list_vector2_t_free(&tex_coords);
+	// the triangles come in whatever order the exporter walked them
+	lite_engine_gl_mesh_cache_stats_t cache_before = lite_engine_gl_mesh_analyze_vertex_cache(
+			&indices, &submeshes, vertices.length, LITE_ENGINE_GL_MESH_VERTEX_CACHE_SIZE);
+	lite_engine_gl_mesh_optimize(&vertices, &indices, &submeshes, LITE_ENGINE_GL_MESH_OPTIMIZE_ALL);
+	lite_engine_gl_mesh_cache_stats_t cache_after = lite_engine_gl_mesh_analyze_vertex_cache(
+			&indices, &submeshes, vertices.length, LITE_ENGINE_GL_MESH_VERTEX_CACHE_SIZE);
+
+	debug_log("Optimized '%s' for a %u entry vertex cache, ACMR %.3f -> %.3f, ATVR %.3f -> %.3f",
+			file_path, LITE_ENGINE_GL_MESH_VERTEX_CACHE_SIZE,
+			cache_before.acmr, cache_after.acmr, cache_before.atvr, cache_after.atvr);
+
+	mesh_t mesh = lite_engine_gl_mesh_alloc_submeshes(vertices, indices, submeshes);
+
+	size_t index_bytes_before = sizeof(GLuint) * mesh.index_count;
+	size_t index_bytes_after  = lite_engine_gl_mesh_index_size(mesh.index_type) * mesh.index_count;
+	debug_log("Welded '%s' from %zu to %u vertices with %u bit indices, "
+			"buffers %zu -> %zu bytes, index reads per draw %zu -> %zu bytes",
+			file_path, read_vertices, mesh.vertex_count, 8 * lite_engine_gl_mesh_index_size(mesh.index_type),
+			sizeof(vertex_t) * read_vertices + index_bytes_before,
+			sizeof(vertex_t) * mesh.vertex_count + index_bytes_after,
+			index_bytes_before, index_bytes_after);
 
-	mesh_t mesh = lite_engine_gl_mesh_alloc(vertices, indices);
 	return mesh;
 }
 
 void lite_engine_gl_mesh_free(mesh_t *mesh) {
+	free(mesh->submeshes);
+	mesh->submeshes     = NULL;
+	mesh->submesh_count = 0;
 	list_vertex_t_free(&mesh->vertices);
 	list_GLuint_free(&mesh->indices);
 }
@@ -0,0 +1,321 @@
+#include "lite_engine_gl.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// binary .lmodb meshes. the text .lmod stays the authoring format, this is
+// what it gets cooked into so loading is an mmap and two glBufferData calls
+// straight from the mapping, with no parsing and no copies on our side.
+//
+// layout, in the byte order of the machine that wrote it:
+//
+//	header            lmod_binary_header_t
+//	submeshes         submesh_count * lmod_binary_submesh_t, at submesh_offset
+//	vertices          vertex_count  * vertex_t, at vertex_offset
+//	indices           index_count   * GLushort or GLuint, at index_offset
+//
+// the header records the size and modification time of the text file the
+// mesh was cooked from. the blobs start on LMOD_BINARY_ALIGNMENT byte
+// boundaries. the indices are stored in the mesh's index type, so 16 bit
+// ones go to GL as they are. a file from another version, byte order or
+// vertex_t layout, cooked from a different source, with blobs or submesh
+// ranges outside its buffers or with indices outside their submesh, is
+// rejected. the caller then falls back to the text file and cooks it again.
+
+#define LMOD_BINARY_MAGIC      "LMDB"
+#define LMOD_BINARY_VERSION    5
+#define LMOD_BINARY_BYTE_ORDER 0x01020304u
+#define LMOD_BINARY_ALIGNMENT  16
+
+typedef struct {
+	char   magic[4];
+	ui32   version;
+	ui32   byte_order;
+	ui32   vertex_size;    // sizeof(vertex_t) of the writer
+	ui32   index_size;     // 2 or 4, see lite_engine_gl_mesh_index_size
+	ui32   vertex_count;
+	ui32   index_count;
+	ui32   submesh_count;
+	ui64   submesh_offset;
+	ui64   vertex_offset;
+	ui64   index_offset;
+	ui64   source_size;
+	ui64   source_mtime_seconds;
+	ui64   source_mtime_nanoseconds;
+	float  bounds_min[3];
+	float  bounds_max[3];
+	float  bounds_center[3];
+	float  bounds_radius;
+} lmod_binary_header_t;
+
+// see submesh_t
+typedef struct {
+	ui32   index_offset;
+	ui32   index_count;
+	ui32   base_vertex;
+	ui32   vertex_count;
+	ui32   material_slot;
+} lmod_binary_submesh_t;
+
+// whether every index stays inside its own submesh's vertices. the ranges
+// have to be checked first. a mesh without submeshes is one range over
+// everything, like lite_engine_gl_mesh_upload makes it.
+static ui8 internal_lmod_binary_indices_valid(const lmod_binary_header_t *header,
+		const lmod_binary_submesh_t *submeshes, const void *indices) {
+	lmod_binary_submesh_t whole = {
+		.index_count  = header->index_count,
+		.vertex_count = header->vertex_count,
+	};
+	ui32 range_count = header->submesh_count > 0 ? header->submesh_count : 1;
+	if (header->submesh_count == 0) {
+		submeshes = &whole;
+	}
+
+	for (ui32 r = 0; r < range_count; r++) {
+		const lmod_binary_submesh_t *s = &submeshes[r];
+		if (header->index_size == sizeof(GLushort)) {
+			const GLushort *narrow = (const GLushort *)indices + s->index_offset;
+			for (ui32 i = 0; i < s->index_count; i++) {
+				if (narrow[i] >= s->vertex_count) {
+					return 0;
+				}
+			}
+		} else {
+			const GLuint *wide = (const GLuint *)indices + s->index_offset;
+			for (ui32 i = 0; i < s->index_count; i++) {
+				if (wide[i] >= s->vertex_count) {
+					return 0;
+				}
+			}
+		}
+	}
+	return 1;
+}
+
+// whether 'count' elements of 'element_size' bytes at 'offset' lie inside a
+// file of 'size' bytes. the offset comes from the file, so it is checked on
+// its own before anything is added to it. the counts are 32 bit, their
+// products can't wrap.
+static ui8 internal_lmod_binary_fits(ui64 offset, ui32 count, ui64 element_size, ui64 size) {
+	return offset <= size && (ui64)count * element_size <= size - offset;
+}
+
+static ui64 internal_lmod_binary_align(ui64 offset) {
+	return (offset + LMOD_BINARY_ALIGNMENT - 1) & ~(ui64)(LMOD_BINARY_ALIGNMENT - 1);
+}
+
+// writes 'size' bytes at 'offset', zero padding from 'position' up to it
+static ui8 internal_lmod_binary_write(FILE *file, ui64 *position, ui64 offset, const void *data, ui64 size) {
+	static const char padding[LMOD_BINARY_ALIGNMENT] = {0};
+
+	if (offset - *position > sizeof(padding) ||
+			fwrite(padding, 1, offset - *position, file) != offset - *position) {
+		return 0;
+	}
+	if (size > 0 && fwrite(data, 1, size, file) != size) {
+		return 0;
+	}
+	*position = offset + size;
+	return 1;
+}
+
+// fills 'source' from the file at 'file_path'. returns 0 if it can't be
+// stat'ed. the modification time has nanoseconds, so an edit within the
+// same second as the last cook still shows.
+ui8 lite_engine_gl_mesh_source_stat(const char *file_path, mesh_source_t *source) {
+	struct stat file_stat;
+	if (stat(file_path, &file_stat) != 0) {
+		return 0;
+	}
+
+	source->size = (ui64)file_stat.st_size;
+#ifdef __APPLE__
+	source->mtime_seconds     = (ui64)file_stat.st_mtimespec.tv_sec;
+	source->mtime_nanoseconds = (ui64)file_stat.st_mtimespec.tv_nsec;
+#else
+	source->mtime_seconds     = (ui64)file_stat.st_mtim.tv_sec;
+	source->mtime_nanoseconds = (ui64)file_stat.st_mtim.tv_nsec;
+#endif
+	return 1;
+}
+
+// cooks 'mesh', read from the text file 'source', into a binary file at
+// 'file_path'. needs the CPU copies of the vertices and indices, so 'mesh'
+// has to come from lite_engine_gl_mesh_alloc. returns 0 if the file could
+// not be written.
+ui8 lite_engine_gl_mesh_binary_write(const char *file_path, const mesh_source_t *source, const mesh_t *mesh) {
+	lmod_binary_submesh_t *submeshes = malloc(sizeof(*submeshes) * mesh->submesh_count);
+	for (ui32 i = 0; i < mesh->submesh_count; i++) {
+		submeshes[i] = (lmod_binary_submesh_t) {
+			.index_offset  = mesh->submeshes[i].index_offset,
+			.index_count   = mesh->submeshes[i].index_count,
+			.base_vertex   = mesh->submeshes[i].base_vertex,
+			.vertex_count  = mesh->submeshes[i].vertex_count,
+			.material_slot = mesh->submeshes[i].material_slot,
+		};
+	}
+	ui64 submeshes_size = sizeof(*submeshes) * mesh->submesh_count;
+
+	// the CPU copy is always 32 bit
+	ui32      index_size = lite_engine_gl_mesh_index_size(mesh->index_type);
+	GLushort *narrowed   = NULL;
+	if (mesh->index_type == GL_UNSIGNED_SHORT) {
+		narrowed = malloc(sizeof(*narrowed) * mesh->indices.length);
+		for (size_t i = 0; i < mesh->indices.length; i++) {
+			narrowed[i] = (GLushort)mesh->indices.array[i];
+		}
+	}
+
+	lmod_binary_header_t header = {
+		.magic                    = LMOD_BINARY_MAGIC,
+		.version                  = LMOD_BINARY_VERSION,
+		.byte_order               = LMOD_BINARY_BYTE_ORDER,
+		.vertex_size              = sizeof(vertex_t),
+		.index_size               = index_size,
+		.vertex_count             = mesh->vertices.length,
+		.index_count              = mesh->indices.length,
+		.submesh_count            = mesh->submesh_count,
+		.source_size              = source->size,
+		.source_mtime_seconds     = source->mtime_seconds,
+		.source_mtime_nanoseconds = source->mtime_nanoseconds,
+		.bounds_min               = { mesh->bounds_min.x,    mesh->bounds_min.y,    mesh->bounds_min.z    },
+		.bounds_max               = { mesh->bounds_max.x,    mesh->bounds_max.y,    mesh->bounds_max.z    },
+		.bounds_center            = { mesh->bounds_center.x, mesh->bounds_center.y, mesh->bounds_center.z },
+		.bounds_radius            = mesh->bounds_radius,
+	};
+	header.submesh_offset = sizeof(header);
+	header.vertex_offset  = internal_lmod_binary_align(header.submesh_offset + submeshes_size);
+	header.index_offset   = internal_lmod_binary_align(header.vertex_offset +
+			(ui64)header.vertex_count * sizeof(vertex_t));
+
+	FILE *file = fopen(file_path, "wb");
+	if (file == NULL) {
+		debug_warn("failed to open '%s' for writing", file_path);
+		free(submeshes);
+		free(narrowed);
+		return 0;
+	}
+
+	ui64 position = 0;
+	ui8  ok       = 1;
+	ok = ok && internal_lmod_binary_write(file, &position, 0,                     &header,  sizeof(header));
+	ok = ok && internal_lmod_binary_write(file, &position, header.submesh_offset, submeshes, submeshes_size);
+	ok = ok && internal_lmod_binary_write(file, &position, header.vertex_offset,
+			mesh->vertices.array, (ui64)header.vertex_count * sizeof(vertex_t));
+	ok = ok && internal_lmod_binary_write(file, &position, header.index_offset,
+			narrowed != NULL ? (const void *)narrowed : (const void *)mesh->indices.array,
+			(ui64)header.index_count * index_size);
+	ok = (fclose(file) == 0) && ok;
+	free(submeshes);
+	free(narrowed);
+
+	if (!ok) {
+		debug_warn("failed to write '%s'", file_path);
+		remove(file_path);
+		return 0;
+	}
+
+	return 1;
+}
+
+// loads a binary mesh written by lite_engine_gl_mesh_binary_write into
+// 'mesh'. the vertex and index blobs go to GL straight from the mapping, the
+// mesh keeps no CPU copies. returns 0, without touching 'mesh', if the file
+// is missing, not one this build can read or was not cooked from 'source'
+// as it is now.
+ui8 lite_engine_gl_mesh_binary_alloc(const char *file_path, const mesh_source_t *source, mesh_t *mesh) {
+	int fd = open(file_path, O_RDONLY);
+	if (fd < 0) {
+		return 0;
+	}
+
+	struct stat file_stat;
+	if (fstat(fd, &file_stat) != 0 || (ui64)file_stat.st_size < sizeof(lmod_binary_header_t)) {
+		close(fd);
+		return 0;
+	}
+
+	size_t size    = (size_t)file_stat.st_size;
+	void  *mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (mapping == MAP_FAILED) {
+		debug_warn("failed to map '%s'", file_path);
+		return 0;
+	}
+
+	const lmod_binary_header_t *header = mapping;
+
+	ui8 ok =
+		memcmp(header->magic, LMOD_BINARY_MAGIC, sizeof(header->magic)) == 0 &&
+		header->version     == LMOD_BINARY_VERSION    &&
+		header->byte_order  == LMOD_BINARY_BYTE_ORDER &&
+		header->vertex_size == sizeof(vertex_t)       &&
+		header->source_size              == source->size              &&
+		header->source_mtime_seconds     == source->mtime_seconds     &&
+		header->source_mtime_nanoseconds == source->mtime_nanoseconds &&
+		(header->index_size == sizeof(GLushort) || header->index_size == sizeof(GLuint)) &&
+		header->vertex_offset % LMOD_BINARY_ALIGNMENT == 0 &&
+		header->index_offset  % LMOD_BINARY_ALIGNMENT == 0 &&
+		internal_lmod_binary_fits(header->vertex_offset,  header->vertex_count,  sizeof(vertex_t),              size) &&
+		internal_lmod_binary_fits(header->index_offset,   header->index_count,   header->index_size,            size) &&
+		internal_lmod_binary_fits(header->submesh_offset, header->submesh_count, sizeof(lmod_binary_submesh_t), size) &&
+		header->submesh_offset % sizeof(ui32) == 0;
+
+	const ui8                   *bytes     = mapping;
+	const lmod_binary_submesh_t *submeshes = ok ?
+		(const lmod_binary_submesh_t *)(bytes + header->submesh_offset) : NULL;
+
+	// ranges outside the buffers, or indices outside their range, would make
+	// GL read out of bounds later
+	for (ui32 i = 0; ok && i < header->submesh_count; i++) {
+		ok = (ui64)submeshes[i].index_offset + submeshes[i].index_count  <= header->index_count &&
+		     (ui64)submeshes[i].base_vertex  + submeshes[i].vertex_count <= header->vertex_count;
+	}
+	ok = ok && internal_lmod_binary_indices_valid(header, submeshes, bytes + header->index_offset);
+
+	if (!ok) {
+		debug_warn("'%s' is not a version %u binary mesh of its source for this build, ignoring it",
+				file_path, LMOD_BINARY_VERSION);
+		munmap(mapping, size);
+		return 0;
+	}
+
+	// read front to back once, tell the kernel so it reads ahead
+	madvise(mapping, size, MADV_SEQUENTIAL);
+
+	submesh_t *ranges = malloc(sizeof(*ranges) * (header->submesh_count + 1));
+	for (ui32 i = 0; i < header->submesh_count; i++) {
+		ranges[i] = (submesh_t) {
+			.index_offset  = submeshes[i].index_offset,
+			.index_count   = submeshes[i].index_count,
+			.base_vertex   = submeshes[i].base_vertex,
+			.vertex_count  = submeshes[i].vertex_count,
+			.material_slot = submeshes[i].material_slot,
+		};
+	}
+
+	mesh_t m = {0};
+	m.enabled       = 1;
+	m.bounds_min    = (vector3_t){ header->bounds_min[0],    header->bounds_min[1],    header->bounds_min[2]    };
+	m.bounds_max    = (vector3_t){ header->bounds_max[0],    header->bounds_max[1],    header->bounds_max[2]    };
+	m.bounds_center = (vector3_t){ header->bounds_center[0], header->bounds_center[1], header->bounds_center[2] };
+	m.bounds_radius = header->bounds_radius;
+
+	lite_engine_gl_mesh_upload(&m,
+			(const vertex_t *)(bytes + header->vertex_offset), header->vertex_count,
+			bytes + header->index_offset,
+			header->index_size == sizeof(GLushort) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT,
+			header->index_count,
+			ranges, header->submesh_count);
+
+	// glBufferData copied the data, the mapping is no longer needed
+	munmap(mapping, size);
+	free(ranges);
+
+	*mesh = m;
+	return 1;
+}
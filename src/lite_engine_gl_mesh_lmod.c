@@ -0,0 +1,426 @@
+#include "lite_engine_gl.h"
+
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// text .lmod reader. one pass over the text, no sscanf, no locale and no
+// temporary token copies. every section writes its attribute straight into
+// the interleaved vertex array through its own counter, so sections may come
+// in any order. a 'mesh:' line starts a new submesh. its vertices and
+// indices follow those of the previous one in the shared arrays, its
+// indices count from its own first vertex and it gets the next material
+// slot. an index past the vertices of its own submesh is an error, reported
+// at the line of the largest one.
+
+typedef enum {
+	LMOD_SECTION_NONE,
+	LMOD_SECTION_POSITIONS,
+	LMOD_SECTION_NORMALS,
+	LMOD_SECTION_TEX_COORDS,
+	LMOD_SECTION_INDICES,
+	LMOD_SECTION_COUNT,
+} lmod_section_t;
+
+static const struct {
+	const char *keyword;
+	size_t      length;
+} internal_lmod_keywords[LMOD_SECTION_COUNT] = {
+	[LMOD_SECTION_NONE]       = { "mesh:",                        sizeof("mesh:")                        - 1 },
+	[LMOD_SECTION_POSITIONS]  = { "vertex_positions:",            sizeof("vertex_positions:")            - 1 },
+	[LMOD_SECTION_NORMALS]    = { "vertex_normals:",              sizeof("vertex_normals:")              - 1 },
+	[LMOD_SECTION_TEX_COORDS] = { "vertex_texture_coordinates:",  sizeof("vertex_texture_coordinates:")  - 1 },
+	[LMOD_SECTION_INDICES]    = { "vertex_indices:",              sizeof("vertex_indices:")              - 1 },
+};
+
+// floats per element of each section
+static const ui32 internal_lmod_components[LMOD_SECTION_COUNT] = {
+	[LMOD_SECTION_POSITIONS]  = 3,
+	[LMOD_SECTION_NORMALS]    = 3,
+	[LMOD_SECTION_TEX_COORDS] = 2,
+	[LMOD_SECTION_INDICES]    = 1,
+};
+
+typedef struct {
+	const char    *c;
+	const char    *end;
+	const char    *name;
+	ui32           line;
+
+	lmod_section_t section;
+	ui32           base;                          // first vertex of the current submesh
+	ui32           written[LMOD_SECTION_COUNT];   // elements of each attribute in the current submesh
+	ui32           index_max;                     // largest index of the current submesh
+	ui32           index_max_line;                // and where it was read, 0 if there were none
+
+	vertex_t      *vertices;
+	size_t         vertex_count;
+	size_t         vertex_capacity;
+	GLuint        *indices;
+	size_t         index_count;
+	size_t         index_capacity;
+	submesh_t     *submeshes;
+	size_t         submesh_count;
+	size_t         submesh_capacity;
+} lmod_reader_t;
+
+// exact powers of ten as doubles, enough for the digits an exporter writes
+static const double internal_lmod_powers_of_ten[] = {
+	1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10,
+	1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+#define LMOD_POWER_OF_TEN_MAX 22
+
+// newlines in [c, end). sizes the vertex array before the real pass.
+static size_t internal_lmod_count_lines(const char *c, const char *end) {
+	size_t lines = 0;
+#if defined(__SSE2__)
+	const __m128i newline = _mm_set1_epi8('\n');
+	for (; end - c >= 16; c += 16) {
+		__m128i bytes = _mm_loadu_si128((const __m128i *)c);
+		lines += __builtin_popcount(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, newline)));
+	}
+#endif
+	for (; c < end; c++) {
+		lines += *c == '\n';
+	}
+	return lines;
+}
+
+// skips spaces, tabs and newlines, counting the newlines. every byte from 1
+// to ' ' counts as space.
+static void internal_lmod_skip_space(lmod_reader_t *r) {
+	const char *c = r->c;
+#if defined(__SSE2__)
+	// no block load when there is nothing to skip
+	while (r->end - c >= 16 && (ui8)(*c - 1) < ' ') {
+		__m128i bytes    = _mm_loadu_si128((const __m128i *)c);
+		__m128i above    = _mm_cmpgt_epi8(bytes, _mm_setzero_si128());    // 1 to 127
+		__m128i below    = _mm_cmplt_epi8(bytes, _mm_set1_epi8(' ' + 1)); // up to ' '
+		ui32    space    = _mm_movemask_epi8(_mm_and_si128(above, below));
+		ui32    newlines = _mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8('\n')));
+
+		if (space == 0xffff) {
+			r->line += __builtin_popcount(newlines);
+			c       += 16;
+			continue;
+		}
+
+		ui32 run = __builtin_ctz(~space);
+		r->line += __builtin_popcount(newlines & ((1u << run) - 1));
+		r->c     = c + run;
+		return;
+	}
+#endif
+	for (; c < r->end && (ui8)(*c - 1) < ' '; c++) {
+		r->line += *c == '\n';
+	}
+	r->c = c;
+}
+
+static void internal_lmod_skip_line(lmod_reader_t *r) {
+	const char *newline = memchr(r->c, '\n', r->end - r->c);
+	r->c = newline != NULL ? newline : r->end;
+}
+
+static ui8 internal_lmod_is_digit(char c) {
+	return (ui8)(c - '0') < 10;
+}
+
+// reads [+-]digits[.digits][(e|E)[+-]digits]. the first 19 significant
+// digits are kept in an integer, scaled once by an exact power of ten.
+static ui8 internal_lmod_read_float(lmod_reader_t *r, float *value) {
+	const char *c        = r->c;
+	ui8         negative = 0;
+
+	if (c < r->end && (*c == '-' || *c == '+')) {
+		negative = *c == '-';
+		c++;
+	}
+
+	ui64 mantissa = 0;
+	int  exponent = 0;
+	ui32 digits   = 0;
+	ui32 kept     = 0;
+
+	for (; c < r->end && internal_lmod_is_digit(*c); c++, digits++) {
+		if (kept < 19) {
+			mantissa = mantissa * 10 + (ui64)(*c - '0');
+			kept    += mantissa != 0;
+		} else {
+			exponent++;
+		}
+	}
+	if (c < r->end && *c == '.') {
+		for (c++; c < r->end && internal_lmod_is_digit(*c); c++, digits++) {
+			if (kept < 19) {
+				mantissa = mantissa * 10 + (ui64)(*c - '0');
+				kept    += mantissa != 0;
+				exponent--;
+			}
+		}
+	}
+	if (digits == 0) {
+		return 0;
+	}
+
+	if (c < r->end && (*c == 'e' || *c == 'E')) {
+		c++;
+		ui8 exponent_negative = 0;
+		if (c < r->end && (*c == '-' || *c == '+')) {
+			exponent_negative = *c == '-';
+			c++;
+		}
+		if (c >= r->end || !internal_lmod_is_digit(*c)) {
+			return 0;
+		}
+		int e = 0;
+		for (; c < r->end && internal_lmod_is_digit(*c); c++) {
+			e = e < 10000 ? e * 10 + (*c - '0') : e;
+		}
+		exponent += exponent_negative ? -e : e;
+	}
+
+	double result = (double)mantissa;
+	while (exponent > LMOD_POWER_OF_TEN_MAX) {
+		result   *= internal_lmod_powers_of_ten[LMOD_POWER_OF_TEN_MAX];
+		exponent -= LMOD_POWER_OF_TEN_MAX;
+	}
+	while (exponent < -LMOD_POWER_OF_TEN_MAX) {
+		result   /= internal_lmod_powers_of_ten[LMOD_POWER_OF_TEN_MAX];
+		exponent += LMOD_POWER_OF_TEN_MAX;
+	}
+	result = exponent < 0 ?
+		result / internal_lmod_powers_of_ten[-exponent] :
+		result * internal_lmod_powers_of_ten[exponent];
+
+	*value = (float)(negative ? -result : result);
+	r->c   = c;
+	return 1;
+}
+
+static ui8 internal_lmod_read_index(lmod_reader_t *r, ui32 *value) {
+	const char *c      = r->c;
+	ui64        result = 0;
+
+	if (c >= r->end || !internal_lmod_is_digit(*c)) {
+		return 0;
+	}
+	for (; c < r->end && internal_lmod_is_digit(*c); c++) {
+		result = result * 10 + (ui64)(*c - '0');
+		if (result > UINT32_MAX) {
+			return 0;
+		}
+	}
+
+	*value = (ui32)result;
+	r->c   = c;
+	return 1;
+}
+
+static ui8 internal_lmod_is_separator(const lmod_reader_t *r) {
+	return r->c >= r->end || (ui8)(*r->c - 1) < ' ' || *r->c == '#';
+}
+
+static vertex_t *internal_lmod_vertex(lmod_reader_t *r, ui32 element) {
+	size_t index = (size_t)r->base + element;
+
+	if (index >= r->vertex_capacity) {
+		size_t capacity = r->vertex_capacity * 2 + 64;
+		r->vertices     = realloc(r->vertices, sizeof(*r->vertices) * capacity);
+		memset(r->vertices + r->vertex_capacity, 0, sizeof(*r->vertices) * (capacity - r->vertex_capacity));
+		r->vertex_capacity = capacity;
+	}
+	if (index >= r->vertex_count) {
+		r->vertex_count = index + 1;
+	}
+	return &r->vertices[index];
+}
+
+static ui8 internal_lmod_read_element(lmod_reader_t *r) {
+	ui32 element = r->written[r->section]++;
+
+	if (r->section == LMOD_SECTION_INDICES) {
+		ui32 index;
+		if (!internal_lmod_read_index(r, &index) || !internal_lmod_is_separator(r)) {
+			return 0;
+		}
+		if (r->index_count >= r->index_capacity) {
+			r->index_capacity = r->index_capacity * 2 + 64;
+			r->indices        = realloc(r->indices, sizeof(*r->indices) * r->index_capacity);
+		}
+		r->indices[r->index_count++] = index;
+		if (r->index_max_line == 0 || index > r->index_max) {
+			r->index_max      = index;
+			r->index_max_line = r->line;
+		}
+		return 1;
+	}
+
+	// the components of a vector stay on one line
+	float values[3];
+	ui32  components = internal_lmod_components[r->section];
+	ui32  line       = r->line;
+	for (ui32 i = 0; i < components; i++) {
+		if (i > 0) {
+			internal_lmod_skip_space(r);
+		}
+		if (r->line != line || !internal_lmod_read_float(r, &values[i]) || !internal_lmod_is_separator(r)) {
+			r->line = line;
+			return 0;
+		}
+	}
+
+	vertex_t *vertex = internal_lmod_vertex(r, element);
+	switch (r->section) {
+		case LMOD_SECTION_POSITIONS: {
+			vertex->position = (vector3_t){ values[0], values[1], values[2] };
+		} break;
+		case LMOD_SECTION_NORMALS: {
+			vertex->normal   = (vector3_t){ values[0], values[1], values[2] };
+		} break;
+		case LMOD_SECTION_TEX_COORDS: {
+			vertex->texCoord = (vector2_t){ values[0], values[1] };
+		} break;
+		default: {
+		} break;
+	}
+	return 1;
+}
+
+// finishes the current submesh, an empty one is dropped. returns 0 if one
+// of its indices is past its vertices, which are only all known here.
+static ui8 internal_lmod_end_submesh(lmod_reader_t *r) {
+	submesh_t *submesh = &r->submeshes[r->submesh_count];
+
+	submesh->index_count  = (ui32)(r->index_count  - submesh->index_offset);
+	submesh->vertex_count = (ui32)(r->vertex_count - submesh->base_vertex);
+	if (r->index_max_line != 0 && r->index_max >= submesh->vertex_count) {
+		debug_error("%s:%u: index %u is out of bounds, its submesh has %u vertices",
+				r->name, r->index_max_line, r->index_max, submesh->vertex_count);
+		return 0;
+	}
+	if (submesh->index_count > 0 || submesh->vertex_count > 0) {
+		r->submesh_count++;
+	}
+	return 1;
+}
+
+static void internal_lmod_begin_submesh(lmod_reader_t *r) {
+	if (r->submesh_count >= r->submesh_capacity) {
+		r->submesh_capacity = r->submesh_capacity * 2 + 4;
+		r->submeshes        = realloc(r->submeshes, sizeof(*r->submeshes) * r->submesh_capacity);
+	}
+
+	r->base           = (ui32)r->vertex_count;
+	r->index_max      = 0;
+	r->index_max_line = 0;
+	memset(r->written, 0, sizeof(r->written));
+	r->submeshes[r->submesh_count] = (submesh_t) {
+		.index_offset  = (ui32)r->index_count,
+		.base_vertex   = r->base,
+		.material_slot = (ui32)r->submesh_count,
+	};
+}
+
+// matches the keyword at the cursor, or returns LMOD_SECTION_COUNT
+static lmod_section_t internal_lmod_read_keyword(lmod_reader_t *r) {
+	const char *start = r->c;
+	const char *c     = start;
+	while (c < r->end && !((ui8)(*c - 1) < ' ')) {
+		c++;
+	}
+
+	size_t length = c - start;
+	for (ui32 section = 0; section < LMOD_SECTION_COUNT; section++) {
+		if (internal_lmod_keywords[section].length == length &&
+				memcmp(internal_lmod_keywords[section].keyword, start, length) == 0) {
+			r->c = c;
+			return section;
+		}
+	}
+	return LMOD_SECTION_COUNT;
+}
+
+// parses the .lmod text in 'text' into interleaved vertices, indices and
+// the submesh ranges over them, which replace the contents of the lists.
+// text without a 'mesh:' line is one submesh. 'name' is only used in error
+// messages. returns 0 and logs the line of the first error on failure.
+ui8 lite_engine_gl_mesh_lmod_read(const char *text, size_t length, const char *name,
+		list_vertex_t *vertices, list_GLuint *indices, list_submesh_t *submeshes) {
+	lmod_reader_t r = {
+		.c    = text,
+		.end  = text + length,
+		.name = name,
+		.line = 1,
+	};
+
+	// every element takes at least a line, except indices which share lines
+	size_t lines      = internal_lmod_count_lines(text, text + length);
+	r.vertex_capacity = lines + 1;
+	r.vertices        = calloc(r.vertex_capacity, sizeof(*r.vertices));
+	r.index_capacity  = lines + 1;
+	r.indices         = malloc(sizeof(*r.indices) * r.index_capacity);
+	internal_lmod_begin_submesh(&r);
+
+	for (;;) {
+		internal_lmod_skip_space(&r);
+		if (r.c >= r.end) {
+			break;
+		}
+
+		char c = *r.c;
+		if (c == '#') {
+			internal_lmod_skip_line(&r);
+			continue;
+		}
+
+		if (internal_lmod_is_digit(c) || c == '-' || c == '+' || c == '.') {
+			if (r.section == LMOD_SECTION_NONE) {
+				debug_error("%s:%u: number outside of a section", name, r.line);
+				goto fail;
+			}
+			if (!internal_lmod_read_element(&r)) {
+				debug_error("%s:%u: malformed element in %s", name, r.line,
+						internal_lmod_keywords[r.section].keyword);
+				goto fail;
+			}
+			continue;
+		}
+
+		lmod_section_t section = internal_lmod_read_keyword(&r);
+		if (section == LMOD_SECTION_COUNT) {
+			debug_error("%s:%u: unknown keyword", name, r.line);
+			goto fail;
+		}
+
+		if (section == LMOD_SECTION_NONE) { // mesh: <name>, the name is not used
+			internal_lmod_skip_line(&r);
+			if (!internal_lmod_end_submesh(&r)) {
+				goto fail;
+			}
+			internal_lmod_begin_submesh(&r);
+		}
+		r.section = section;
+	}
+
+	if (!internal_lmod_end_submesh(&r)) {
+		goto fail;
+	}
+
+	free(vertices->array);
+	free(indices->array);
+	free(submeshes->array);
+	*vertices  = (list_vertex_t)  { .capacity = r.vertex_capacity,  .length = r.vertex_count,  .array = r.vertices  };
+	*indices   = (list_GLuint)    { .capacity = r.index_capacity,   .length = r.index_count,   .array = r.indices   };
+	*submeshes = (list_submesh_t) { .capacity = r.submesh_capacity, .length = r.submesh_count, .array = r.submeshes };
+	return 1;
+
+fail:
+	free(r.vertices);
+	free(r.indices);
+	free(r.submeshes);
+	return 0;
+}
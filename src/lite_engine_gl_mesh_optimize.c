@@ -0,0 +1,573 @@
+#include "lite_engine_gl.h"
+
+#include <math.h>
+#include <string.h>
+
+// import time passes over the CPU copies of a mesh. they run before the
+// mesh is uploaded and cooked, so binary meshes get them without paying
+// for them on load.
+
+#define MESH_WELD_EMPTY 0xffffffffu
+#define MESH_NONE       0xffffffffu
+
+// checks that the ranges are in order, which welding needs to compact the
+// vertices in place, that they are inside the buffers and that their
+// indices stay inside their own vertices. 'largest' is set to the vertex
+// count of the biggest range.
+static ui8 internal_mesh_ranges_valid(size_t vertex_count, const list_GLuint *indices,
+		const submesh_t *ranges, size_t range_count, const char *pass, ui32 *largest) {
+	ui64 previous = 0;
+	*largest = 0;
+	for (size_t r = 0; r < range_count; r++) {
+		const submesh_t *s = &ranges[r];
+		if (s->base_vertex < previous ||
+				(ui64)s->base_vertex  + s->vertex_count > vertex_count     ||
+				(ui64)s->index_offset + s->index_count  > indices->length) {
+			debug_warn("not %s, submesh %zu is out of bounds", pass, r);
+			return 0;
+		}
+		for (ui32 i = 0; i < s->index_count; i++) {
+			if (indices->array[s->index_offset + i] >= s->vertex_count) {
+				debug_warn("not %s, index %u of submesh %zu is out of bounds", pass, i, r);
+				return 0;
+			}
+		}
+		previous = (ui64)s->base_vertex + s->vertex_count;
+		*largest = s->vertex_count > *largest ? s->vertex_count : *largest;
+	}
+	return 1;
+}
+
+// quantizes a vertex component to the weld grid, cells 'epsilon' wide
+// centred on its multiples. vertices whose components all land in the same
+// cells are welded.
+static long internal_mesh_weld_cell(float value, float inverse_epsilon) {
+	return lroundf(value * inverse_epsilon);
+}
+
+static ui32 internal_mesh_weld_hash(const vertex_t *vertex, float inverse_epsilon) {
+	const float *components = (const float *)vertex;
+	ui64         hash       = 14695981039346656037ull;
+	for (ui32 i = 0; i < sizeof(vertex_t) / sizeof(float); i++) {
+		hash ^= (ui64)internal_mesh_weld_cell(components[i], inverse_epsilon);
+		hash *= 1099511628211ull;
+	}
+	hash ^= hash >> 33;
+	hash *= 0xff51afd7ed558ccdull;
+	hash ^= hash >> 33;
+	return (ui32)hash;
+}
+
+static ui8 internal_mesh_weld_equal(const vertex_t *a, const vertex_t *b, float inverse_epsilon) {
+	const float *x = (const float *)a;
+	const float *y = (const float *)b;
+	for (ui32 i = 0; i < sizeof(vertex_t) / sizeof(float); i++) {
+		if (internal_mesh_weld_cell(x[i], inverse_epsilon) != internal_mesh_weld_cell(y[i], inverse_epsilon)) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+// welds vertices whose position, texture coordinate and normal components
+// round to the same multiples of 'epsilon' and rewrites the indices to
+// match. this is grid quantization, not a distance test: copies of a vertex
+// always weld, but two values a hair apart on either side of a cell edge do
+// not, and values almost 'epsilon' apart inside one cell do. the first of each
+// group is kept. submeshes are welded separately, since their indices count
+// from their own base vertex, and their ranges are updated. an empty
+// 'submeshes' is one range over everything. returns 0, changing nothing, if
+// a range or an index is out of bounds.
+ui8 lite_engine_gl_mesh_weld(list_vertex_t *vertices, list_GLuint *indices, list_submesh_t *submeshes,
+		float epsilon) {
+	submesh_t  whole       = { .index_count = indices->length, .vertex_count = vertices->length };
+	submesh_t *ranges      = submeshes->length > 0 ? submeshes->array  : &whole;
+	size_t     range_count = submeshes->length > 0 ? submeshes->length : 1;
+
+	ui32 largest;
+	if (!internal_mesh_ranges_valid(vertices->length, indices, ranges, range_count, "welding", &largest)) {
+		return 0;
+	}
+
+	size_t capacity = 16;
+	while (capacity < (size_t)largest * 2) {
+		capacity *= 2;
+	}
+
+	ui32  *table           = malloc(sizeof(*table) * capacity);
+	ui32  *remap           = malloc(sizeof(*remap) * (largest + 1));
+	float  inverse_epsilon = 1.0f / epsilon;
+	ui32   written         = 0;
+
+	for (size_t r = 0; r < range_count; r++) {
+		submesh_t *s = &ranges[r];
+
+		size_t mask = 16;
+		while (mask < (size_t)s->vertex_count * 2) {
+			mask *= 2;
+		}
+		mask -= 1;
+		memset(table, 0xff, sizeof(*table) * (mask + 1));
+
+		// the kept vertices are written from the front of the range down to
+		// 'written', never past the one being read
+		vertex_t *source = vertices->array + s->base_vertex;
+		vertex_t *target = vertices->array + written;
+		ui32      unique = 0;
+
+		for (ui32 i = 0; i < s->vertex_count; i++) {
+			size_t slot = internal_mesh_weld_hash(&source[i], inverse_epsilon) & mask;
+			while (table[slot] != MESH_WELD_EMPTY &&
+					!internal_mesh_weld_equal(&target[table[slot]], &source[i], inverse_epsilon)) {
+				slot = (slot + 1) & mask;
+			}
+			if (table[slot] == MESH_WELD_EMPTY) {
+				table[slot] = unique;
+				if (&target[unique] != &source[i]) {
+					target[unique] = source[i];
+				}
+				unique++;
+			}
+			remap[i] = table[slot];
+		}
+
+		GLuint *range_indices = indices->array + s->index_offset;
+		for (ui32 i = 0; i < s->index_count; i++) {
+			range_indices[i] = remap[range_indices[i]];
+		}
+
+		s->base_vertex  = written;
+		s->vertex_count = unique;
+		written        += unique;
+	}
+
+	vertices->length = written;
+
+	free(table);
+	free(remap);
+	return 1;
+}
+
+// vertex cache optimization after Tom Forsyth, "Linear-Speed Vertex Cache
+// Optimisation". triangles are emitted greedily, always the one whose
+// vertices score highest. a vertex scores for being recently used, in a
+// modelled LRU cache, and for having few triangles left, so that stray
+// triangles are finished off instead of left behind to be missed later.
+
+#define MESH_FORSYTH_CACHE_SIZE     32
+#define MESH_FORSYTH_DECAY_POWER    1.5f
+#define MESH_FORSYTH_LAST_TRIANGLE  0.75f
+#define MESH_FORSYTH_VALENCE_SCALE  2.0f
+#define MESH_FORSYTH_VALENCE_POWER  0.5f
+#define MESH_FORSYTH_VALENCE_MAX    32
+
+typedef struct {
+	float cache[MESH_FORSYTH_CACHE_SIZE];
+	float valence[MESH_FORSYTH_VALENCE_MAX];
+} mesh_forsyth_scores_t;
+
+static void internal_mesh_forsyth_scores(mesh_forsyth_scores_t *scores) {
+	for (ui32 i = 0; i < MESH_FORSYTH_CACHE_SIZE; i++) {
+		// the three vertices of the last triangle score the same, otherwise
+		// the order they were emitted in would matter
+		scores->cache[i] = i < 3 ? MESH_FORSYTH_LAST_TRIANGLE :
+			powf(1.0f - (float)(i - 3) / (MESH_FORSYTH_CACHE_SIZE - 3), MESH_FORSYTH_DECAY_POWER);
+	}
+	for (ui32 i = 1; i < MESH_FORSYTH_VALENCE_MAX; i++) {
+		scores->valence[i] = MESH_FORSYTH_VALENCE_SCALE * powf((float)i, -MESH_FORSYTH_VALENCE_POWER);
+	}
+	scores->valence[0] = 0;
+}
+
+static float internal_mesh_forsyth_score(const mesh_forsyth_scores_t *scores, int cache_position,
+		ui32 remaining) {
+	if (remaining == 0) {
+		return -1.0f;
+	}
+	float score = cache_position >= 0 ? scores->cache[cache_position] : 0.0f;
+	score += remaining < MESH_FORSYTH_VALENCE_MAX ? scores->valence[remaining] :
+		MESH_FORSYTH_VALENCE_SCALE * powf((float)remaining, -MESH_FORSYTH_VALENCE_POWER);
+	return score;
+}
+
+// reorders the triangles of one range. 'indices' count from 0 and are all
+// below 'vertex_count'.
+static void internal_mesh_optimize_vertex_cache(GLuint *indices, ui32 triangle_count, ui32 vertex_count) {
+	if (triangle_count == 0) {
+		return;
+	}
+
+	mesh_forsyth_scores_t scores;
+	internal_mesh_forsyth_scores(&scores);
+
+	// the triangles using each vertex, in adjacency[offsets[v]..offsets[v] + remaining[v]]
+	ui32   *offsets        = calloc(vertex_count + 1, sizeof(*offsets));
+	ui32   *remaining      = calloc(vertex_count,     sizeof(*remaining));
+	ui32   *adjacency      = malloc(sizeof(*adjacency)      * triangle_count * 3);
+	int    *cache_position = malloc(sizeof(*cache_position) * vertex_count);
+	float  *vertex_score   = malloc(sizeof(*vertex_score)   * vertex_count);
+	float  *triangle_score = malloc(sizeof(*triangle_score) * triangle_count);
+	ui8    *emitted        = calloc(triangle_count, sizeof(*emitted));
+	GLuint *output         = malloc(sizeof(*output)         * triangle_count * 3);
+
+	for (ui32 i = 0; i < triangle_count * 3; i++) {
+		offsets[indices[i] + 1]++;
+	}
+	for (ui32 v = 0; v < vertex_count; v++) {
+		offsets[v + 1] += offsets[v];
+	}
+	for (ui32 i = 0; i < triangle_count * 3; i++) {
+		GLuint v = indices[i];
+		adjacency[offsets[v] + remaining[v]++] = i / 3;
+	}
+
+	for (ui32 v = 0; v < vertex_count; v++) {
+		cache_position[v] = -1;
+		vertex_score[v]   = internal_mesh_forsyth_score(&scores, -1, remaining[v]);
+	}
+
+	ui32 best = 0;
+	for (ui32 t = 0; t < triangle_count; t++) {
+		const GLuint *c = &indices[t * 3];
+		triangle_score[t] = vertex_score[c[0]] + vertex_score[c[1]] + vertex_score[c[2]];
+		best = triangle_score[t] > triangle_score[best] ? t : best;
+	}
+
+	// three more than the cache, for the vertices pushed out by a triangle
+	ui32 cache[MESH_FORSYTH_CACHE_SIZE + 3];
+	ui32 cache_length = 0;
+	ui32 cursor       = 0;
+
+	for (ui32 written = 0; written < triangle_count; written++) {
+		if (best == MESH_NONE) {
+			// dead end, nothing in the cache has triangles left. carry on
+			// with the next unemitted triangle in the original order
+			while (emitted[cursor]) {
+				cursor++;
+			}
+			best = cursor;
+		}
+
+		const GLuint *corners = &indices[best * 3];
+		output[written * 3 + 0] = corners[0];
+		output[written * 3 + 1] = corners[1];
+		output[written * 3 + 2] = corners[2];
+		emitted[best] = 1;
+
+		for (ui32 k = 0; k < 3; k++) {
+			GLuint v    = corners[k];
+			ui32  *list = &adjacency[offsets[v]];
+			for (ui32 a = 0; a < remaining[v]; a++) {
+				if (list[a] == best) {
+					list[a] = list[--remaining[v]];
+					break;
+				}
+			}
+		}
+
+		// the triangle's vertices move to the front, the rest shift back
+		ui32 next[MESH_FORSYTH_CACHE_SIZE + 3];
+		ui32 next_length = 0;
+		for (ui32 k = 0; k < 3; k++) {
+			if ((k < 1 || corners[k] != corners[0]) && (k < 2 || corners[k] != corners[1])) {
+				next[next_length++] = corners[k];
+			}
+		}
+		for (ui32 c = 0; c < cache_length; c++) {
+			GLuint v = cache[c];
+			if (v != corners[0] && v != corners[1] && v != corners[2]) {
+				next[next_length++] = v;
+			}
+		}
+
+		for (ui32 c = 0; c < next_length; c++) {
+			GLuint v = next[c];
+			cache_position[v] = c < MESH_FORSYTH_CACHE_SIZE ? (int)c : -1;
+			vertex_score[v]   = internal_mesh_forsyth_score(&scores, cache_position[v], remaining[v]);
+		}
+
+		// rescore the triangles around every vertex whose score changed and
+		// pick the best of them. only these can have gained on the others
+		best = MESH_NONE;
+		float best_score = -1.0f;
+		for (ui32 c = 0; c < next_length; c++) {
+			GLuint      v    = next[c];
+			const ui32 *list = &adjacency[offsets[v]];
+			for (ui32 a = 0; a < remaining[v]; a++) {
+				ui32          t = list[a];
+				const GLuint *k = &indices[t * 3];
+				triangle_score[t] = vertex_score[k[0]] + vertex_score[k[1]] + vertex_score[k[2]];
+				if (triangle_score[t] > best_score || (triangle_score[t] == best_score && t < best)) {
+					best       = t;
+					best_score = triangle_score[t];
+				}
+			}
+		}
+
+		cache_length = next_length < MESH_FORSYTH_CACHE_SIZE ? next_length : MESH_FORSYTH_CACHE_SIZE;
+		memcpy(cache, next, sizeof(*cache) * cache_length);
+	}
+
+	memcpy(indices, output, sizeof(*output) * triangle_count * 3);
+
+	free(offsets);
+	free(remaining);
+	free(adjacency);
+	free(cache_position);
+	free(vertex_score);
+	free(triangle_score);
+	free(emitted);
+	free(output);
+}
+
+// misses of a FIFO vertex cache of 'cache_size' entries. a vertex is in the
+// cache while fewer than 'cache_size' misses happened since it was loaded.
+// 'stamps' holds one counter per vertex, 'time' is the miss counter and
+// starts 'cache_size' + 1 ahead of every stamp, which is an empty cache.
+static ui32 internal_mesh_cache_misses(const GLuint *triangle, ui32 *stamps, ui32 *time, ui32 cache_size) {
+	ui32 misses = 0;
+	for (ui32 k = 0; k < 3; k++) {
+		GLuint v = triangle[k];
+		if (*time - stamps[v] > cache_size) {
+			stamps[v] = (*time)++;
+			misses++;
+		}
+	}
+	return misses;
+}
+
+typedef struct {
+	float key;
+	ui32  start;
+	ui32  count;
+} mesh_cluster_t;
+
+// outward facing clusters first, ties in the order the clusters came in
+static int internal_mesh_cluster_compare(const void *a, const void *b) {
+	const mesh_cluster_t *x = a;
+	const mesh_cluster_t *y = b;
+	if (x->key != y->key) {
+		return x->key > y->key ? -1 : 1;
+	}
+	return x->start < y->start ? -1 : x->start > y->start;
+}
+
+// overdraw reduction after Sander, Nehab and Barczak, "Fast Triangle
+// Reordering for Vertex Locality and Reduced Overdraw". the cache optimized
+// order is cut into clusters that keep their cache efficiency to within
+// 'threshold' of the cluster they were cut from, and the clusters are
+// drawn outside in, so the ones most likely to be in front go first.
+static void internal_mesh_optimize_overdraw(const vertex_t *vertices, GLuint *indices,
+		ui32 triangle_count, ui32 vertex_count, float threshold) {
+	if (triangle_count == 0) {
+		return;
+	}
+
+	ui32            cache_size    = LITE_ENGINE_GL_MESH_VERTEX_CACHE_SIZE;
+	ui32           *stamps        = calloc(vertex_count, sizeof(*stamps));
+	ui8            *misses        = malloc(sizeof(*misses)   * triangle_count);
+	ui32           *hard          = malloc(sizeof(*hard)     * triangle_count);
+	mesh_cluster_t *clusters      = malloc(sizeof(*clusters) * triangle_count);
+	ui32            hard_count    = 0;
+	ui32            cluster_count = 0;
+	ui32            time          = cache_size + 1;
+
+	// hard boundaries, where the optimizer jumped somewhere new and every
+	// vertex of the triangle missed
+	for (ui32 t = 0; t < triangle_count; t++) {
+		misses[t] = internal_mesh_cache_misses(&indices[t * 3], stamps, &time, cache_size);
+		if (t == 0 || misses[t] == 3) {
+			hard[hard_count++] = t;
+		}
+	}
+
+	// soft boundaries, as soon as a cluster is as cache efficient as the
+	// hard cluster it is cut from
+	for (ui32 h = 0; h < hard_count; h++) {
+		ui32 start = hard[h];
+		ui32 end   = h + 1 < hard_count ? hard[h + 1] : triangle_count;
+
+		ui32 hard_misses = 0;
+		for (ui32 t = start; t < end; t++) {
+			hard_misses += misses[t];
+		}
+		float target = threshold * (float)hard_misses / (float)(end - start);
+
+		ui32 cluster_start  = start;
+		ui32 cluster_misses = 0;
+		time += cache_size + 1;
+		for (ui32 t = start; t < end; t++) {
+			cluster_misses += internal_mesh_cache_misses(&indices[t * 3], stamps, &time, cache_size);
+			if (t + 1 == end || (float)cluster_misses / (float)(t + 1 - cluster_start) <= target) {
+				clusters[cluster_count++] = (mesh_cluster_t) {
+					.start = cluster_start,
+					.count = t + 1 - cluster_start,
+				};
+				cluster_start  = t + 1;
+				cluster_misses = 0;
+				time += cache_size + 1;
+			}
+		}
+	}
+
+	// area weighted centroids and normals, of the mesh and of each cluster
+	vector3_t mesh_centroid = {0};
+	float     mesh_area     = 0;
+	for (ui32 t = 0; t < triangle_count; t++) {
+		vector3_t a    = vertices[indices[t * 3 + 0]].position;
+		vector3_t b    = vertices[indices[t * 3 + 1]].position;
+		vector3_t c    = vertices[indices[t * 3 + 2]].position;
+		float     area = vector3_magnitude(vector3_cross(vector3_subtract(b, a), vector3_subtract(c, a)));
+		mesh_centroid  = vector3_add(mesh_centroid, vector3_scale(vector3_add(vector3_add(a, b), c), area));
+		mesh_area     += area;
+	}
+	mesh_centroid = vector3_scale(mesh_centroid, mesh_area > 0 ? 1.0f / (3.0f * mesh_area) : 0.0f);
+
+	for (ui32 i = 0; i < cluster_count; i++) {
+		mesh_cluster_t *cluster  = &clusters[i];
+		vector3_t       centroid = {0};
+		vector3_t       normal   = {0};
+		float           area     = 0;
+		for (ui32 t = cluster->start; t < cluster->start + cluster->count; t++) {
+			vector3_t a      = vertices[indices[t * 3 + 0]].position;
+			vector3_t b      = vertices[indices[t * 3 + 1]].position;
+			vector3_t c      = vertices[indices[t * 3 + 2]].position;
+			vector3_t cross  = vector3_cross(vector3_subtract(b, a), vector3_subtract(c, a));
+			float     weight = vector3_magnitude(cross);
+			centroid = vector3_add(centroid, vector3_scale(vector3_add(vector3_add(a, b), c), weight));
+			normal   = vector3_add(normal, cross);
+			area    += weight;
+		}
+		centroid = vector3_scale(centroid, area > 0 ? 1.0f / (3.0f * area) : 0.0f);
+
+		float length = vector3_magnitude(normal);
+		normal = vector3_scale(normal, length > 0 ? 1.0f / length : 0.0f);
+
+		cluster->key = vector3_dot(vector3_subtract(centroid, mesh_centroid), normal);
+	}
+
+	qsort(clusters, cluster_count, sizeof(*clusters), internal_mesh_cluster_compare);
+
+	GLuint *output  = malloc(sizeof(*output) * triangle_count * 3);
+	ui32    written = 0;
+	for (ui32 i = 0; i < cluster_count; i++) {
+		memcpy(&output[written], &indices[clusters[i].start * 3], sizeof(*output) * clusters[i].count * 3);
+		written += clusters[i].count * 3;
+	}
+	memcpy(indices, output, sizeof(*output) * triangle_count * 3);
+
+	free(stamps);
+	free(misses);
+	free(clusters);
+	free(hard);
+	free(output);
+}
+
+// renumbers the vertices of one range in the order the indices first use
+// them, so vertex fetches walk the buffer front to back. unused vertices
+// go last.
+static void internal_mesh_optimize_vertex_fetch(vertex_t *vertices, GLuint *indices, ui32 index_count,
+		ui32 vertex_count) {
+	ui32 *remap = malloc(sizeof(*remap) * vertex_count);
+	memset(remap, 0xff, sizeof(*remap) * vertex_count);
+
+	ui32 next = 0;
+	for (ui32 i = 0; i < index_count; i++) {
+		if (remap[indices[i]] == MESH_NONE) {
+			remap[indices[i]] = next++;
+		}
+		indices[i] = remap[indices[i]];
+	}
+	for (ui32 v = 0; v < vertex_count; v++) {
+		if (remap[v] == MESH_NONE) {
+			remap[v] = next++;
+		}
+	}
+
+	vertex_t *copy = malloc(sizeof(*copy) * vertex_count);
+	memcpy(copy, vertices, sizeof(*copy) * vertex_count);
+	for (ui32 v = 0; v < vertex_count; v++) {
+		vertices[remap[v]] = copy[v];
+	}
+
+	free(copy);
+	free(remap);
+}
+
+// reorders the triangles and vertices of every submesh for the GPU, with
+// the passes 'flags' selects from LITE_ENGINE_GL_MESH_OPTIMIZE_*. the
+// result only depends on the input, so it can be cooked. an empty
+// 'submeshes' is one range over everything. returns 0, changing nothing,
+// if a range or an index is out of bounds.
+ui8 lite_engine_gl_mesh_optimize(list_vertex_t *vertices, list_GLuint *indices, list_submesh_t *submeshes,
+		ui32 flags) {
+	submesh_t  whole       = { .index_count = indices->length, .vertex_count = vertices->length };
+	submesh_t *ranges      = submeshes->length > 0 ? submeshes->array  : &whole;
+	size_t     range_count = submeshes->length > 0 ? submeshes->length : 1;
+
+	ui32 largest;
+	if (!internal_mesh_ranges_valid(vertices->length, indices, ranges, range_count, "optimizing", &largest)) {
+		return 0;
+	}
+
+	for (size_t r = 0; r < range_count; r++) {
+		const submesh_t *s              = &ranges[r];
+		vertex_t        *range_vertices = vertices->array + s->base_vertex;
+		GLuint          *range_indices  = indices->array  + s->index_offset;
+		ui32             triangle_count = s->index_count / 3;
+
+		if (flags & LITE_ENGINE_GL_MESH_OPTIMIZE_VERTEX_CACHE) {
+			internal_mesh_optimize_vertex_cache(range_indices, triangle_count, s->vertex_count);
+		}
+		if (flags & LITE_ENGINE_GL_MESH_OPTIMIZE_OVERDRAW) {
+			internal_mesh_optimize_overdraw(range_vertices, range_indices, triangle_count, s->vertex_count,
+					LITE_ENGINE_GL_MESH_OVERDRAW_THRESHOLD);
+		}
+		if (flags & LITE_ENGINE_GL_MESH_OPTIMIZE_VERTEX_FETCH) {
+			internal_mesh_optimize_vertex_fetch(range_vertices, range_indices, s->index_count, s->vertex_count);
+		}
+	}
+
+	return 1;
+}
+
+// simulates a FIFO post-transform cache of 'cache_size' entries over every
+// submesh, each draw starting with an empty cache. ACMR is vertices
+// transformed per triangle, from 3 down to about 0.5 for a regular grid.
+// ATVR is vertices transformed per vertex, 1 at best. an empty 'submeshes'
+// is one range over everything. both are 0 if a range or an index is out
+// of bounds.
+lite_engine_gl_mesh_cache_stats_t lite_engine_gl_mesh_analyze_vertex_cache(const list_GLuint *indices,
+		const list_submesh_t *submeshes, ui32 vertex_count, ui32 cache_size) {
+	submesh_t        whole       = { .index_count = indices->length, .vertex_count = vertex_count };
+	const submesh_t *ranges      = submeshes->length > 0 ? submeshes->array  : &whole;
+	size_t           range_count = submeshes->length > 0 ? submeshes->length : 1;
+
+	ui32 largest;
+	if (!internal_mesh_ranges_valid(vertex_count, indices, ranges, range_count, "analyzing", &largest)) {
+		return (lite_engine_gl_mesh_cache_stats_t) {0};
+	}
+
+	ui64 transformed = 0;
+	ui64 triangles   = 0;
+	ui64 vertices    = 0;
+
+	for (size_t r = 0; r < range_count; r++) {
+		const submesh_t *s      = &ranges[r];
+		ui32            *stamps = calloc(s->vertex_count + 1, sizeof(*stamps));
+		ui32             time   = cache_size + 1;
+
+		for (ui32 t = 0; t < s->index_count / 3; t++) {
+			transformed += internal_mesh_cache_misses(&indices->array[s->index_offset + t * 3],
+					stamps, &time, cache_size);
+		}
+		triangles += s->index_count / 3;
+		vertices  += s->vertex_count;
+		free(stamps);
+	}
+
+	return (lite_engine_gl_mesh_cache_stats_t) {
+		.acmr = triangles > 0 ? (float)transformed / (float)triangles : 0.0f,
+		.atvr = vertices  > 0 ? (float)transformed / (float)vertices  : 0.0f,
+	};
+}
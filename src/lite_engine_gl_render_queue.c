@@ -0,0 +1,312 @@
+#include "lite_engine_gl.h"
+
+#include <string.h>
+
+// sort key layout, most significant bits first. packets are drawn in key
+// order, so the fields that are most expensive to switch come first.
+//
+//   63      62        52       44       36        24      20         0
+//   | pass  | shader  | diffuse | specular | VAO    | range | depth     |
+//   | 2     | 10      | 8       | 8        | 12     | 4     | 20        |
+//
+// GL object names are truncated to fit and the submesh range is hashed.
+// two packets sharing a key field only end up less well grouped,
+// submission always compares the real values. the range keeps instances of
+// the same submesh together when several submeshes share a VAO.
+#define RENDER_QUEUE_KEY_PASS_SHIFT     62
+#define RENDER_QUEUE_KEY_SHADER_SHIFT   52
+#define RENDER_QUEUE_KEY_DIFFUSE_SHIFT  44
+#define RENDER_QUEUE_KEY_SPECULAR_SHIFT 36
+#define RENDER_QUEUE_KEY_VAO_SHIFT      24
+#define RENDER_QUEUE_KEY_RANGE_SHIFT    20
+
+typedef struct {
+	ui64 key;
+	ui32 packet;
+} render_queue_entry_t;
+
+typedef struct {
+	GLuint                                 shader;
+	lite_engine_gl_shader_uniform_handle_t model_matrix;
+	lite_engine_gl_shader_uniform_handle_t normal_matrix;
+	lite_engine_gl_shader_uniform_handle_t material_diffuse;
+	lite_engine_gl_shader_uniform_handle_t material_specular;
+	lite_engine_gl_shader_uniform_handle_t material_shininess;
+} render_queue_uniforms_t;
+
+typedef struct {
+	vector3_t                           camera_position;
+	ui32                                length;
+	ui32                                capacity;
+	lite_engine_gl_render_packet_t     *packets;
+	render_queue_entry_t               *entries;
+	render_queue_entry_t               *entries_scratch;
+	ui32                                instances_capacity;
+	lite_engine_gl_instance_t          *instances;
+} render_queue_t;
+
+// one queue per frame in flight. with a render thread the simulation builds
+// one of them while the render thread submits another, otherwise both sides
+// use the first.
+static render_queue_t                      internal_render_queues[LITE_ENGINE_GL_FRAMES_MAX];
+static ui32                                internal_render_queue_build_frame;
+static ui32                                internal_render_queue_submit_frame;
+static lite_engine_gl_render_queue_stats_t internal_render_queue_stats;
+
+static ui64 internal_render_queue_key(const lite_engine_gl_render_packet_t *p, vector3_t camera_position) {
+	ui64 pass = p->use_wire_frame ?
+		LITE_ENGINE_GL_RENDER_PASS_WIRE_FRAME :
+		LITE_ENGINE_GL_RENDER_PASS_OPAQUE;
+
+	// front to back. a positive float's bit pattern sorts like the float
+	// itself, keep the top 20 bits of the squared distance.
+	vector3_t position = {
+		p->model_matrix.elements[12],
+		p->model_matrix.elements[13],
+		p->model_matrix.elements[14],
+	};
+	float distance = vector3_square_distance(position, camera_position);
+	ui32  distance_bits;
+	memcpy(&distance_bits, &distance, sizeof(distance_bits));
+
+	return
+		(pass                             << RENDER_QUEUE_KEY_PASS_SHIFT)     |
+		((ui64)(p->shader      & 0x3ff)  << RENDER_QUEUE_KEY_SHADER_SHIFT)   |
+		((ui64)(p->diffuseMap  & 0xff)   << RENDER_QUEUE_KEY_DIFFUSE_SHIFT)  |
+		((ui64)(p->specularMap & 0xff)   << RENDER_QUEUE_KEY_SPECULAR_SHIFT) |
+		((ui64)(p->VAO         & 0xfff)  << RENDER_QUEUE_KEY_VAO_SHIFT)      |
+		((ui64)((p->index_offset * 2654435761u) >> 28) << RENDER_QUEUE_KEY_RANGE_SHIFT) |
+		((ui64)(distance_bits >> 12));
+}
+
+// picks the queue that begin, push and sort work on.
+void lite_engine_gl_render_queue_set_build_frame(ui32 frame) {
+	internal_render_queue_build_frame = frame;
+}
+
+// picks the queue that submit draws.
+void lite_engine_gl_render_queue_set_submit_frame(ui32 frame) {
+	internal_render_queue_submit_frame = frame;
+}
+
+void lite_engine_gl_render_queue_begin(vector3_t camera_position) {
+	render_queue_t *q = &internal_render_queues[internal_render_queue_build_frame];
+	q->camera_position = camera_position;
+	q->length          = 0;
+}
+
+void lite_engine_gl_render_queue_push(const lite_engine_gl_render_packet_t *packet) {
+	lite_engine_gl_render_queue_set(lite_engine_gl_render_queue_reserve(1), packet);
+}
+
+// makes room for 'count' packets and returns the index of the first. the
+// slots are filled with lite_engine_gl_render_queue_set, which may run on
+// several threads at once as long as no other reserve happens meanwhile.
+ui32 lite_engine_gl_render_queue_reserve(ui32 count) {
+	render_queue_t *q = &internal_render_queues[internal_render_queue_build_frame];
+
+	if (q->length + count > q->capacity) {
+		q->capacity        = (q->length + count) * 2 + 64;
+		q->packets         = realloc(q->packets,         sizeof(*q->packets)         * q->capacity);
+		q->entries         = realloc(q->entries,         sizeof(*q->entries)         * q->capacity);
+		q->entries_scratch = realloc(q->entries_scratch, sizeof(*q->entries_scratch) * q->capacity);
+	}
+
+	ui32 first = q->length;
+	q->length += count;
+	return first;
+}
+
+void lite_engine_gl_render_queue_set(ui32 index, const lite_engine_gl_render_packet_t *packet) {
+	render_queue_t *q = &internal_render_queues[internal_render_queue_build_frame];
+
+	q->packets[index] = *packet;
+	q->entries[index] = (render_queue_entry_t) {
+		.key    = internal_render_queue_key(packet, q->camera_position),
+		.packet = index,
+	};
+}
+
+// least significant digit first radix sort over the 64 bit keys, 8 bits per
+// pass. passes where every key has the same digit are skipped, which is the
+// common case for the high bits of a scene with only a few shaders.
+void lite_engine_gl_render_queue_sort(void) {
+	render_queue_t       *q   = &internal_render_queues[internal_render_queue_build_frame];
+	render_queue_entry_t *src = q->entries;
+	render_queue_entry_t *dst = q->entries_scratch;
+
+	for (ui32 shift = 0; shift < 64; shift += 8) {
+		ui32 counts[256] = {0};
+		for (ui32 i = 0; i < q->length; i++) {
+			counts[(src[i].key >> shift) & 0xff]++;
+		}
+
+		if (q->length == 0 || counts[(src[0].key >> shift) & 0xff] == q->length) {
+			continue;
+		}
+
+		ui32 offset = 0;
+		for (ui32 d = 0; d < 256; d++) {
+			ui32 count = counts[d];
+			counts[d]  = offset;
+			offset    += count;
+		}
+
+		for (ui32 i = 0; i < q->length; i++) {
+			dst[counts[(src[i].key >> shift) & 0xff]++] = src[i];
+		}
+
+		render_queue_entry_t *swap = src;
+		src = dst;
+		dst = swap;
+	}
+
+	q->entries         = src;
+	q->entries_scratch = dst;
+}
+
+static void internal_render_queue_uniforms_resolve(render_queue_uniforms_t *u, GLuint shader) {
+	u->shader             = shader;
+	u->model_matrix       = lite_engine_gl_shader_get_uniform_handle(shader, "u_modelMatrix");
+	u->normal_matrix      = lite_engine_gl_shader_get_uniform_handle(shader, "u_normalMatrix");
+	u->material_diffuse   = lite_engine_gl_shader_get_uniform_handle(shader, "u_material.diffuse");
+	u->material_specular  = lite_engine_gl_shader_get_uniform_handle(shader, "u_material.specular");
+	u->material_shininess = lite_engine_gl_shader_get_uniform_handle(shader, "u_material.shininess");
+}
+
+// binds everything 'p' needs through the GL state cache, which drops the
+// binds that would not change anything.
+static void internal_render_queue_bind(
+		render_queue_uniforms_t              *uniforms,
+		const lite_engine_gl_render_packet_t *p,
+		GLuint                                shader) {
+	lite_engine_gl_state_polygon_mode(p->use_wire_frame ? GL_LINE : GL_FILL);
+	lite_engine_gl_state_use_program(shader);
+
+	if (uniforms->shader != shader) {
+		// sampler units and shininess are the same for every material
+		// so they only need setting once per program.
+		internal_render_queue_uniforms_resolve(uniforms, shader);
+		lite_engine_gl_shader_setUniformHandleInt   (uniforms->material_diffuse,   0);
+		lite_engine_gl_shader_setUniformHandleInt   (uniforms->material_specular,  1);
+		lite_engine_gl_shader_setUniformHandleFloat (uniforms->material_shininess, 32.0f);
+	}
+
+	lite_engine_gl_state_bind_texture(0, p->diffuseMap);
+	lite_engine_gl_state_bind_texture(1, p->specularMap);
+	lite_engine_gl_state_bind_vertex_array(p->VAO);
+}
+
+// byte offset of the packet's submesh in the bound index buffer
+static const void *internal_render_queue_indices(const lite_engine_gl_render_packet_t *p) {
+	return (const void *)((size_t)lite_engine_gl_mesh_index_size(p->index_type) * p->index_offset);
+}
+
+// two packets can share one instanced draw when they use the same submesh
+// and the same material
+static ui8 internal_render_queue_can_instance(
+		const lite_engine_gl_render_packet_t *a,
+		const lite_engine_gl_render_packet_t *b) {
+	return
+		a->VAO              == b->VAO              &&
+		a->index_count      == b->index_count      &&
+		a->index_offset     == b->index_offset     &&
+		a->base_vertex      == b->base_vertex      &&
+		a->shader           == b->shader           &&
+		a->shader_instanced == b->shader_instanced &&
+		a->diffuseMap       == b->diffuseMap       &&
+		a->specularMap      == b->specularMap      &&
+		a->use_wire_frame   == b->use_wire_frame;
+}
+
+// draws every packet in key order. binds go through the GL state cache so
+// state is only touched when it differs from the packet drawn before.
+// sorting puts packets sharing a mesh and a material next to each other,
+// each such run is drawn with a single instanced draw call when the
+// material has an instanced shader.
+void lite_engine_gl_render_queue_submit(void) {
+	render_queue_t              *q        = &internal_render_queues[internal_render_queue_submit_frame];
+	render_queue_uniforms_t      uniforms = { .shader = 0 };
+	lite_engine_gl_state_stats_t before   = lite_engine_gl_state_get_stats();
+
+	lite_engine_gl_render_queue_stats_t stats = { .packets = q->length };
+
+	for (ui32 i = 0; i < q->length;) {
+		lite_engine_gl_render_packet_t *p = &q->packets[q->entries[i].packet];
+
+		ui32 run = 1;
+		if (p->shader_instanced != 0) {
+			while (i + run < q->length && internal_render_queue_can_instance(
+						p, &q->packets[q->entries[i + run].packet])) {
+				run++;
+			}
+		}
+
+		if (run >= LITE_ENGINE_GL_INSTANCING_THRESHOLD) {
+			if (run > q->instances_capacity) {
+				q->instances_capacity = run * 2;
+				q->instances = realloc(q->instances,
+						sizeof(*q->instances) * q->instances_capacity);
+			}
+
+			for (ui32 r = 0; r < run; r++) {
+				lite_engine_gl_render_packet_t *instance = &q->packets[q->entries[i + r].packet];
+				q->instances[r] = (lite_engine_gl_instance_t) {
+					.model_matrix  = instance->model_matrix,
+					.normal_matrix = instance->normal_matrix,
+				};
+			}
+
+			// orphan and refill, the driver hands back fresh storage instead
+			// of waiting on draws still reading last frame's instances.
+			lite_engine_gl_state_bind_buffer(GL_ARRAY_BUFFER, p->instance_VBO);
+			glBufferData(GL_ARRAY_BUFFER, sizeof(*q->instances) * run, q->instances,
+					GL_STREAM_DRAW);
+
+			internal_render_queue_bind(&uniforms, p, p->shader_instanced);
+			glDrawElementsInstancedBaseVertex(GL_TRIANGLES, p->index_count, p->index_type,
+					internal_render_queue_indices(p), run, p->base_vertex);
+
+			stats.instanced_draw_calls++;
+			stats.instances += run;
+		} else {
+			for (ui32 r = 0; r < run; r++) {
+				lite_engine_gl_render_packet_t *single = &q->packets[q->entries[i + r].packet];
+				internal_render_queue_bind(&uniforms, single, single->shader);
+				lite_engine_gl_shader_setUniformHandleM4(uniforms.model_matrix,
+						&single->model_matrix);
+				lite_engine_gl_shader_setUniformHandleM3(uniforms.normal_matrix,
+						&single->normal_matrix);
+				glDrawElementsBaseVertex(GL_TRIANGLES, single->index_count, single->index_type,
+						internal_render_queue_indices(single), single->base_vertex);
+				stats.draw_calls++;
+			}
+		}
+
+		i += run;
+	}
+
+	lite_engine_gl_state_stats_t after = lite_engine_gl_state_get_stats();
+
+	stats.draw_calls         += stats.instanced_draw_calls;
+	stats.state_changes       = after.issued - before.issued;
+	stats.state_changes_saved = after.elided - before.elided;
+	internal_render_queue_stats = stats;
+}
+
+lite_engine_gl_render_queue_stats_t lite_engine_gl_render_queue_get_stats(void) {
+	return internal_render_queue_stats;
+}
+
+void lite_engine_gl_render_queue_free(void) {
+	for (ui32 i = 0; i < LITE_ENGINE_GL_FRAMES_MAX; i++) {
+		render_queue_t *q = &internal_render_queues[i];
+		free(q->packets);
+		free(q->entries);
+		free(q->entries_scratch);
+		free(q->instances);
+		*q = (render_queue_t) {0};
+	}
+	internal_render_queue_build_frame  = 0;
+	internal_render_queue_submit_frame = 0;
+}
@@ -0,0 +1,155 @@
+#include "lite_engine_gl.h"
+
+#define GLFW_INCLUDE_NONE
+#include <GLFW/glfw3.h>
+
+#include <pthread.h>
+
+// optional render thread. it owns the GL context and draws frame N while
+// lite_engine_update simulates frame N + 1.
+//
+// the render queue keeps one queue per slot and this module keeps the
+// matching lite_engine_gl_frame_t. at the start of a frame the simulation
+// acquires the slot it builds into, at the end it publishes it. the render
+// thread draws published slots in order and hands them back afterwards.
+// with 'frame_latency' L there are L + 1 slots, so the simulation blocks
+// once it is L frames ahead of the frame being drawn.
+//
+// everything the render thread reads is a copy made by the simulation, so
+// it never touches entities. GL resources (meshes, shaders, textures) still
+// have to be created while the main thread owns the context, in
+// lite_engine_gl_start, before the render thread takes it over.
+
+typedef struct {
+	pthread_t               thread;
+	GLFWwindow             *window;
+	ui8                     running;
+	ui32                    slots;
+
+	lite_engine_gl_frame_t  frames[LITE_ENGINE_GL_FRAMES_MAX];
+	ui64                    published; // frames handed to the render thread
+	ui64                    drawn;     // frames it is done with
+
+	pthread_mutex_t         mutex;
+	pthread_cond_t          frame_published;
+	pthread_cond_t          frame_drawn;
+} render_thread_t;
+
+static render_thread_t internal_render_thread = {
+	.mutex           = PTHREAD_MUTEX_INITIALIZER,
+	.frame_published = PTHREAD_COND_INITIALIZER,
+	.frame_drawn     = PTHREAD_COND_INITIALIZER,
+};
+
+static void *internal_render_thread_main(void *argument) {
+	(void)argument;
+	render_thread_t *r = &internal_render_thread;
+
+	glfwMakeContextCurrent(r->window);
+
+	pthread_mutex_lock(&r->mutex);
+	for (;;) {
+		while (r->drawn == r->published && r->running) {
+			pthread_cond_wait(&r->frame_published, &r->mutex);
+		}
+		if (r->drawn == r->published) { // stopped and nothing left to draw
+			break;
+		}
+
+		ui32                   slot  = r->drawn % r->slots;
+		lite_engine_gl_frame_t frame = r->frames[slot];
+		pthread_mutex_unlock(&r->mutex);
+
+		lite_engine_gl_draw_frame(&frame, slot);
+
+		pthread_mutex_lock(&r->mutex);
+		r->drawn++;
+		pthread_cond_signal(&r->frame_drawn);
+	}
+	pthread_mutex_unlock(&r->mutex);
+
+	glfwMakeContextCurrent(NULL);
+
+	return NULL;
+}
+
+// hands the GL context of 'window' to a new render thread. the calling
+// thread must own the context and loses it.
+void lite_engine_gl_render_thread_start(struct GLFWwindow *window, ui32 frame_latency) {
+	render_thread_t *r = &internal_render_thread;
+
+	if (frame_latency < 1) {
+		frame_latency = 1;
+	}
+	if (frame_latency > LITE_ENGINE_GL_FRAME_LATENCY_MAX) {
+		debug_warn("frame latency %u is too high, using %u",
+				frame_latency, LITE_ENGINE_GL_FRAME_LATENCY_MAX);
+		frame_latency = LITE_ENGINE_GL_FRAME_LATENCY_MAX;
+	}
+
+	r->window    = window;
+	r->slots     = frame_latency + 1;
+	r->published = 0;
+	r->drawn     = 0;
+	r->running   = 1;
+
+	glfwMakeContextCurrent(NULL);
+
+	if (pthread_create(&r->thread, NULL, internal_render_thread_main, NULL) != 0) {
+		debug_error("failed to create the render thread, rendering on the main thread");
+		r->running = 0;
+		glfwMakeContextCurrent(window);
+		return;
+	}
+
+	debug_log("render thread started, %u frames of latency", frame_latency);
+}
+
+// draws the frames still queued, joins the render thread and gives the GL
+// context back to the calling thread.
+void lite_engine_gl_render_thread_stop(void) {
+	render_thread_t *r = &internal_render_thread;
+
+	if (!r->running) {
+		return;
+	}
+
+	pthread_mutex_lock(&r->mutex);
+	r->running = 0;
+	pthread_cond_signal(&r->frame_published);
+	pthread_mutex_unlock(&r->mutex);
+
+	pthread_join(r->thread, NULL);
+
+	glfwMakeContextCurrent(r->window);
+}
+
+ui8 lite_engine_gl_render_thread_is_running(void) {
+	return internal_render_thread.running;
+}
+
+// returns the slot the next frame is built into, waiting while the render
+// thread still needs every slot.
+ui32 lite_engine_gl_render_thread_acquire_slot(void) {
+	render_thread_t *r = &internal_render_thread;
+
+	pthread_mutex_lock(&r->mutex);
+	while (r->published - r->drawn >= r->slots) {
+		pthread_cond_wait(&r->frame_drawn, &r->mutex);
+	}
+	ui32 slot = r->published % r->slots;
+	pthread_mutex_unlock(&r->mutex);
+
+	return slot;
+}
+
+// queues the acquired slot for drawing, together with 'frame'.
+void lite_engine_gl_render_thread_publish(const lite_engine_gl_frame_t *frame) {
+	render_thread_t *r = &internal_render_thread;
+
+	pthread_mutex_lock(&r->mutex);
+	r->frames[r->published % r->slots] = *frame;
+	r->published++;
+	pthread_cond_signal(&r->frame_published);
+	pthread_mutex_unlock(&r->mutex);
+}
@@ -1,5 +1,176 @@
 #include "lite_engine_gl.h"
 
+#include <string.h>
+
+// uniform reflection table for one linked program. built once at link time
+// by enumerating GL_ACTIVE_UNIFORMS so that setting a uniform never has to
+// ask the driver for a location again. names the enumeration does not list,
+// like "lights[1].diffuse", are looked up once on first use and cached.
+typedef struct {
+	ui32           hash;
+	GLint          location;
+	char          *name;      // NULL for an empty slot
+} shader_uniform_t;
+
+typedef struct {
+	GLuint            program;
+	ui32              uniforms_capacity; // always a power of two
+	ui32              uniforms_count;
+	shader_uniform_t *uniforms;
+} shader_program_t;
+DECLARE_LIST(shader_program_t)
+DEFINE_LIST(shader_program_t)
+
+static list_shader_program_t internal_shader_programs;
+static shader_program_t     *internal_shader_program_last = NULL;
+
+// FNV-1a
+static ui32 internal_shader_hash(const char *name) {
+	ui32 hash = 2166136261u;
+	for (const char *c = name; *c != '\0'; c++) {
+		hash ^= (ui8)*c;
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+// the slot holding 'name', or the empty slot it would go in
+static shader_uniform_t *internal_shader_uniform_slot(shader_program_t *p, const char *name, ui32 hash) {
+	ui32 mask = p->uniforms_capacity - 1;
+	for (ui32 i = hash & mask;; i = (i + 1) & mask) {
+		shader_uniform_t *u = &p->uniforms[i];
+		if (u->name == NULL || (u->hash == hash && strcmp(u->name, name) == 0)) {
+			return u;
+		}
+	}
+}
+
+// doubles the table, keeping it under half full
+static void internal_shader_uniform_grow(shader_program_t *p) {
+	shader_uniform_t *old          = p->uniforms;
+	ui32              old_capacity = p->uniforms_capacity;
+
+	p->uniforms_capacity *= 2;
+	p->uniforms           = calloc(sizeof(*p->uniforms), p->uniforms_capacity);
+	for (ui32 i = 0; i < old_capacity; i++) {
+		if (old[i].name != NULL) {
+			*internal_shader_uniform_slot(p, old[i].name, old[i].hash) = old[i];
+		}
+	}
+	free(old);
+}
+
+static void internal_shader_uniform_insert(shader_program_t *p, const char *name, GLint location) {
+	if ((p->uniforms_count + 1) * 2 > p->uniforms_capacity) {
+		internal_shader_uniform_grow(p);
+	}
+
+	ui32              hash = internal_shader_hash(name);
+	shader_uniform_t *u    = internal_shader_uniform_slot(p, name, hash);
+	if (u->name != NULL) {
+		return;
+	}
+
+	size_t length = strlen(name) + 1;
+	u->hash       = hash;
+	u->location   = location;
+	u->name       = malloc(length);
+	memcpy(u->name, name, length);
+	p->uniforms_count++;
+}
+
+static void internal_shader_reflect(GLuint program) {
+	if (internal_shader_programs.array == NULL) {
+		internal_shader_programs = list_shader_program_t_alloc();
+	}
+
+	GLint count      = 0;
+	GLint max_length = 0;
+	glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+	glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_length);
+
+	// arrays are registered twice, as "name[0]" and as "name", so leave
+	// enough room to stay under half full.
+	shader_program_t p = { .program = program, .uniforms_capacity = 16 };
+	while (p.uniforms_capacity < (ui32)count * 4) {
+		p.uniforms_capacity *= 2;
+	}
+	p.uniforms = calloc(sizeof(*p.uniforms), p.uniforms_capacity);
+
+	// the length includes the terminator
+	char *name = malloc(max_length > 0 ? max_length : 1);
+	for (GLint i = 0; i < count; i++) {
+		GLsizei length = 0;
+		GLint   size   = 0;
+		GLenum  type   = 0;
+		glGetActiveUniform(program, i, max_length, &length, &size, &type, name);
+
+		GLint location = glGetUniformLocation(program, name);
+		if (location < 0) {
+			continue; // uniform block members have no location
+		}
+
+		internal_shader_uniform_insert(&p, name, location);
+
+		char *bracket = strchr(name, '[');
+		if (bracket != NULL) {
+			*bracket = '\0';
+			internal_shader_uniform_insert(&p, name, location);
+		}
+	}
+	free(name);
+
+	list_shader_program_t_add(&internal_shader_programs, p);
+	internal_shader_program_last = NULL; // the list may have moved
+}
+
+static shader_program_t *internal_shader_program_find(GLuint program) {
+	if (internal_shader_program_last != NULL &&
+			internal_shader_program_last->program == program) {
+		return internal_shader_program_last;
+	}
+	for (size_t i = 0; i < internal_shader_programs.length; i++) {
+		if (internal_shader_programs.array[i].program == program) {
+			internal_shader_program_last = &internal_shader_programs.array[i];
+			return internal_shader_program_last;
+		}
+	}
+	return NULL;
+}
+
+lite_engine_gl_shader_uniform_handle_t lite_engine_gl_shader_get_uniform_handle(
+		GLuint shader, const char *uniformName) {
+	shader_program_t *p = internal_shader_program_find(shader);
+	if (p == NULL) { // not created through lite_engine_gl_shader_create
+		return glGetUniformLocation(shader, uniformName);
+	}
+
+	shader_uniform_t *u = internal_shader_uniform_slot(p, uniformName, internal_shader_hash(uniformName));
+	if (u->name != NULL) {
+		return u->location;
+	}
+
+	// not in the table, ask the driver once. unknown names are cached too,
+	// as -1, which glUniform* ignores.
+	GLint location = glGetUniformLocation(shader, uniformName);
+	internal_shader_uniform_insert(p, uniformName, location);
+	return location;
+}
+
+// frees the uniform tables of every program lite_engine_gl_shader_create
+// made. the programs themselves belong to GL.
+void lite_engine_gl_shader_stop(void) {
+	for (size_t i = 0; i < internal_shader_programs.length; i++) {
+		shader_program_t *p = &internal_shader_programs.array[i];
+		for (ui32 u = 0; u < p->uniforms_capacity; u++) {
+			free(p->uniforms[u].name);
+		}
+		free(p->uniforms);
+	}
+	list_shader_program_t_free(&internal_shader_programs);
+	internal_shader_program_last = NULL;
+}
+
 static GLuint internal_shader_compile(GLuint type, const char *source) {
 	/*creation*/
 	GLuint shader = 0;
@@ -88,6 +259,9 @@ GLuint lite_engine_gl_shader_create(
 
 	glValidateProgram(program);
 
+	lite_engine_gl_uniform_buffer_bind_program(program);
+	internal_shader_reflect(program);
+
 	file_buffer_free(vertex_source_string);
 	file_buffer_free(fragment_source_string);
 
@@ -95,26 +269,53 @@ GLuint lite_engine_gl_shader_create(
 }
 
 void lite_engine_gl_shader_setUniformInt(GLuint shader, const char *uniformName, GLuint i) {
-	GLuint UniformLocation = glGetUniformLocation(shader, uniformName);
-	glUniform1i(UniformLocation, i);
+	glUniform1i(lite_engine_gl_shader_get_uniform_handle(shader, uniformName), i);
 }
 
 void lite_engine_gl_shader_setUniformFloat(GLuint shader, const char *uniformName, GLfloat f) {
-	GLuint UniformLocation = glGetUniformLocation(shader, uniformName);
-	glUniform1f(UniformLocation, f);
+	glUniform1f(lite_engine_gl_shader_get_uniform_handle(shader, uniformName), f);
 }
 
 void lite_engine_gl_shader_setUniformV3(GLuint shader, const char *uniformName, vector3_t v) {
-	GLuint UniformLocation = glGetUniformLocation(shader, uniformName);
-	glUniform3f(UniformLocation, v.x, v.y, v.z);
+	glUniform3f(lite_engine_gl_shader_get_uniform_handle(shader, uniformName), v.x, v.y, v.z);
 }
 
 void lite_engine_gl_shader_setUniformV4(GLuint shader, const char *uniformName, vector4_t v) {
-	GLuint UniformLocation = glGetUniformLocation(shader, uniformName);
-	glUniform4f(UniformLocation, v.x, v.y, v.z, v.w);
+	glUniform4f(lite_engine_gl_shader_get_uniform_handle(shader, uniformName), v.x, v.y, v.z, v.w);
 }
 
 void lite_engine_gl_shader_setUniformM4(GLuint shader, const char *uniformName, matrix4_t *m) {
-	GLuint UniformLocation = glGetUniformLocation(shader, uniformName);
-	glUniformMatrix4fv(UniformLocation, 1, GL_FALSE, &m->elements[0]);
+	glUniformMatrix4fv(lite_engine_gl_shader_get_uniform_handle(shader, uniformName),
+			1, GL_FALSE, &m->elements[0]);
+}
+
+void lite_engine_gl_shader_setUniformM3(GLuint shader, const char *uniformName, matrix3_t *m) {
+	glUniformMatrix3fv(lite_engine_gl_shader_get_uniform_handle(shader, uniformName),
+			1, GL_FALSE, &m->elements[0]);
+}
+
+// handle based setters. these never touch a string, resolve the handle once
+// with lite_engine_gl_shader_get_uniform_handle and keep it around.
+void lite_engine_gl_shader_setUniformHandleInt(lite_engine_gl_shader_uniform_handle_t handle, GLint i) {
+	glUniform1i(handle, i);
+}
+
+void lite_engine_gl_shader_setUniformHandleFloat(lite_engine_gl_shader_uniform_handle_t handle, GLfloat f) {
+	glUniform1f(handle, f);
+}
+
+void lite_engine_gl_shader_setUniformHandleV3(lite_engine_gl_shader_uniform_handle_t handle, vector3_t v) {
+	glUniform3f(handle, v.x, v.y, v.z);
+}
+
+void lite_engine_gl_shader_setUniformHandleV4(lite_engine_gl_shader_uniform_handle_t handle, vector4_t v) {
+	glUniform4f(handle, v.x, v.y, v.z, v.w);
+}
+
+void lite_engine_gl_shader_setUniformHandleM4(lite_engine_gl_shader_uniform_handle_t handle, matrix4_t *m) {
+	glUniformMatrix4fv(handle, 1, GL_FALSE, &m->elements[0]);
+}
+
+void lite_engine_gl_shader_setUniformHandleM3(lite_engine_gl_shader_uniform_handle_t handle, matrix3_t *m) {
+	glUniformMatrix3fv(handle, 1, GL_FALSE, &m->elements[0]);
 }
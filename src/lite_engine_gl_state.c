@@ -0,0 +1,158 @@
+#include "lite_engine_gl.h"
+
+// shadow copy of the GL state lite-engine touches. every bind goes through
+// here and is only forwarded to the driver when it would change something.
+//
+// element array buffer bindings are part of the vertex array object and are
+// never cached. anything not tracked here is always forwarded.
+
+#define STATE_TEXTURE_UNITS 16
+
+enum {
+	STATE_CAPABILITY_CULL_FACE,
+	STATE_CAPABILITY_DEPTH_TEST,
+	STATE_CAPABILITY_BLEND,
+	STATE_CAPABILITY_COUNT,
+};
+
+typedef struct {
+	GLuint                       program;
+	GLuint                       VAO;
+	GLuint                       array_buffer;
+	GLuint                       uniform_buffer;
+	GLenum                       polygon_mode;
+	GLuint                       active_texture_unit;
+	GLuint                       textures[STATE_TEXTURE_UNITS];
+	ui8                          capabilities[STATE_CAPABILITY_COUNT];
+	lite_engine_gl_state_stats_t stats;
+} gl_state_t;
+
+static gl_state_t internal_gl_state;
+
+// sets the shadow state to the defaults of a freshly created context.
+// call once the context is current, before any other lite_engine_gl_state_* call.
+void lite_engine_gl_state_start(void) {
+	internal_gl_state = (gl_state_t) {
+		.polygon_mode = GL_FILL,
+	};
+}
+
+lite_engine_gl_state_stats_t lite_engine_gl_state_get_stats(void) {
+	return internal_gl_state.stats;
+}
+
+static int internal_gl_state_capability(GLenum capability) {
+	switch(capability) {
+		case GL_CULL_FACE:  return STATE_CAPABILITY_CULL_FACE;
+		case GL_DEPTH_TEST: return STATE_CAPABILITY_DEPTH_TEST;
+		case GL_BLEND:      return STATE_CAPABILITY_BLEND;
+		default:            return -1;
+	}
+}
+
+void lite_engine_gl_state_enable(GLenum capability) {
+	int index = internal_gl_state_capability(capability);
+	if (index >= 0 && internal_gl_state.capabilities[index]) {
+		internal_gl_state.stats.elided++;
+		return;
+	}
+	if (index >= 0) {
+		internal_gl_state.capabilities[index] = 1;
+	}
+	glEnable(capability);
+	internal_gl_state.stats.issued++;
+}
+
+void lite_engine_gl_state_disable(GLenum capability) {
+	int index = internal_gl_state_capability(capability);
+	if (index >= 0 && !internal_gl_state.capabilities[index]) {
+		internal_gl_state.stats.elided++;
+		return;
+	}
+	if (index >= 0) {
+		internal_gl_state.capabilities[index] = 0;
+	}
+	glDisable(capability);
+	internal_gl_state.stats.issued++;
+}
+
+void lite_engine_gl_state_use_program(GLuint program) {
+	if (internal_gl_state.program == program) {
+		internal_gl_state.stats.elided++;
+		return;
+	}
+	internal_gl_state.program = program;
+	glUseProgram(program);
+	internal_gl_state.stats.issued++;
+}
+
+void lite_engine_gl_state_polygon_mode(GLenum mode) {
+	if (internal_gl_state.polygon_mode == mode) {
+		internal_gl_state.stats.elided++;
+		return;
+	}
+	internal_gl_state.polygon_mode = mode;
+	glPolygonMode(GL_FRONT_AND_BACK, mode);
+	internal_gl_state.stats.issued++;
+}
+
+void lite_engine_gl_state_bind_vertex_array(GLuint VAO) {
+	if (internal_gl_state.VAO == VAO) {
+		internal_gl_state.stats.elided++;
+		return;
+	}
+	internal_gl_state.VAO = VAO;
+	glBindVertexArray(VAO);
+	internal_gl_state.stats.issued++;
+}
+
+static GLuint *internal_gl_state_buffer(GLenum target) {
+	switch(target) {
+		case GL_ARRAY_BUFFER:   return &internal_gl_state.array_buffer;
+		case GL_UNIFORM_BUFFER: return &internal_gl_state.uniform_buffer;
+		default:                return NULL;
+	}
+}
+
+void lite_engine_gl_state_bind_buffer(GLenum target, GLuint buffer) {
+	GLuint *bound = internal_gl_state_buffer(target);
+	if (bound != NULL && *bound == buffer) {
+		internal_gl_state.stats.elided++;
+		return;
+	}
+	if (bound != NULL) {
+		*bound = buffer;
+	}
+	glBindBuffer(target, buffer);
+	internal_gl_state.stats.issued++;
+}
+
+// glBindBufferBase also replaces the generic binding of 'target'
+void lite_engine_gl_state_bind_buffer_base(GLenum target, GLuint index, GLuint buffer) {
+	GLuint *bound = internal_gl_state_buffer(target);
+	if (bound != NULL) {
+		*bound = buffer;
+	}
+	glBindBufferBase(target, index, buffer);
+	internal_gl_state.stats.issued++;
+}
+
+// binds a 2D texture to 'unit', switching the active texture unit first if needed
+void lite_engine_gl_state_bind_texture(GLuint unit, GLuint texture) {
+	assert(unit < STATE_TEXTURE_UNITS);
+
+	if (internal_gl_state.textures[unit] == texture) {
+		internal_gl_state.stats.elided++;
+		return;
+	}
+
+	if (internal_gl_state.active_texture_unit != unit) {
+		internal_gl_state.active_texture_unit = unit;
+		glActiveTexture(GL_TEXTURE0 + unit);
+		internal_gl_state.stats.issued++;
+	}
+
+	internal_gl_state.textures[unit] = texture;
+	glBindTexture(GL_TEXTURE_2D, texture);
+	internal_gl_state.stats.issued++;
+}
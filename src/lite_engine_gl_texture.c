@@ -8,7 +8,7 @@ GLuint lite_engine_gl_texture_create(const char *imageFile) {
 	/*create texture*/
 	GLuint texture;
 	glGenTextures(1, &texture);
-	glBindTexture(GL_TEXTURE_2D, texture);
+	lite_engine_gl_state_bind_texture(0, texture);
 
 	/*set parameters*/
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
@@ -39,7 +39,5 @@ GLuint lite_engine_gl_texture_create(const char *imageFile) {
 	/*cleanup*/
 	stbi_image_free(data);
 
-	glBindTexture(GL_TEXTURE_2D, 0);
-
 	return texture;
 }
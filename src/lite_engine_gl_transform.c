@@ -1,21 +1,357 @@
 #include "lite_engine_gl.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 DEFINE_LIST(transform_t)
 
+static matrix3_t internal_transform_normal_matrix_trs(const matrix4_t *m, vector3_t scale);
+
+static lite_engine_gl_transform_stats_t internal_transform_stats;
+static float                            internal_transform_alpha = 1.0f;
+
+// scratch for lite_engine_gl_transform_update_batch
+typedef struct {
+	size_t        capacity;
+	transform_t **transforms;
+	float        *soa;      // ten arrays of 'capacity' floats
+	matrix4_t    *matrices;
+} transform_batch_t;
+
+static transform_batch_t internal_transform_batch;
+
+// the state to render 't' with: the previous and current state blended by
+// 'alpha'. rotations are normalized lerps along the shorter arc, which is
+// close enough to a slerp over one fixed step.
+static void internal_transform_blend(const transform_t *t, float alpha,
+		vector3_t *position, quaternion_t *rotation, vector3_t *scale) {
+	if (!t->previous_valid || alpha >= 1.0f) {
+		*position = t->position;
+		*rotation = t->rotation;
+		*scale    = t->scale;
+		return;
+	}
+
+	*position = vector3_lerp(t->previous_position, t->position, alpha);
+	*scale    = vector3_lerp(t->previous_scale,    t->scale,    alpha);
+
+	quaternion_t a   = t->previous_rotation;
+	quaternion_t b   = t->rotation;
+	float        dot = a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w;
+	float        sb  = dot < 0.0f ? -alpha : alpha;
+	float        sa  = 1.0f - alpha;
+	quaternion_t q   = {
+		.x = a.x * sa + b.x * sb,
+		.y = a.y * sa + b.y * sb,
+		.z = a.z * sa + b.z * sb,
+		.w = a.w * sa + b.w * sb,
+	};
+	*rotation = quaternion_normalize(q);
+}
+
+static ui8 internal_transform_is_moving(const transform_t *t) {
+	return t->previous_valid && (
+		t->previous_position.x != t->position.x ||
+		t->previous_position.y != t->position.y ||
+		t->previous_position.z != t->position.z ||
+		t->previous_rotation.x != t->rotation.x ||
+		t->previous_rotation.y != t->rotation.y ||
+		t->previous_rotation.z != t->rotation.z ||
+		t->previous_rotation.w != t->rotation.w ||
+		t->previous_scale.x    != t->scale.x    ||
+		t->previous_scale.y    != t->scale.y    ||
+		t->previous_scale.z    != t->scale.z);
+}
+
+// 1 if the caches of 't' have to be rebuilt: it changed, or it moved during
+// the last fixed step and the interpolation alpha changed since.
+ui8 lite_engine_gl_transform_is_stale(const transform_t *t) {
+	if (!t->matrix_valid) {
+		return 1;
+	}
+	return t->matrix_alpha != internal_transform_alpha && internal_transform_is_moving(t);
+}
+
+// rebuilds the matrix and normal matrix caches unconditionally. the matrix
+// is T * R * S composed directly, see lite_engine_gl_transform_batch.c
 void lite_engine_gl_transform_calculate_matrix(transform_t *t) {
-	matrix4_t translation = matrix4_translate(t->position);
-	matrix4_t rotation = quaternion_to_matrix4(t->rotation);
-	matrix4_t scale = matrix4_scale(t->scale);
-	t->matrix = matrix4_multiply(rotation, translation);
-	t->matrix = matrix4_multiply(scale, t->matrix);
-}
-
-void lite_engine_gl_transform_calculate_view_matrix(transform_t *t) {
-	matrix4_t translation = matrix4_translate(vector3_negate(t->position));
-	matrix4_t rotation = quaternion_to_matrix4(quaternion_conjugate(t->rotation));
-	matrix4_t scale = matrix4_scale(t->scale);
-	t->matrix = matrix4_multiply(translation, rotation);
-	t->matrix = matrix4_multiply(scale, t->matrix);
+	vector3_t    position;
+	quaternion_t rotation;
+	vector3_t    scale;
+	internal_transform_blend(t, internal_transform_alpha, &position, &rotation, &scale);
+
+	float x = rotation.x;
+	float y = rotation.y;
+	float z = rotation.z;
+	float w = rotation.w;
+
+	float xx = x * x, xy = x * y, xz = x * z, xw = x * w;
+	float yy = y * y, yz = y * z, yw = y * w;
+	float zz = z * z, zw = z * w;
+
+	float *m = t->matrix.elements;
+	m[0]  = (1 - 2 * (yy + zz)) * scale.x;
+	m[1]  =      2 * (xy + zw)  * scale.x;
+	m[2]  =      2 * (xz - yw)  * scale.x;
+	m[3]  = 0;
+	m[4]  =      2 * (xy - zw)  * scale.y;
+	m[5]  = (1 - 2 * (xx + zz)) * scale.y;
+	m[6]  =      2 * (yz + xw)  * scale.y;
+	m[7]  = 0;
+	m[8]  =      2 * (xz + yw)  * scale.z;
+	m[9]  =      2 * (yz - xw)  * scale.z;
+	m[10] = (1 - 2 * (xx + yy)) * scale.z;
+	m[11] = 0;
+	m[12] = position.x;
+	m[13] = position.y;
+	m[14] = position.z;
+	m[15] = 1;
+
+	t->normal_matrix = internal_transform_normal_matrix_trs(&t->matrix, scale);
+	t->matrix_alpha  = internal_transform_alpha;
+	t->matrix_valid  = 1;
+}
+
+// rebuilds the caches only if the transform changed since they were last
+// built. returns 1 if they were rebuilt.
+ui8 lite_engine_gl_transform_update(transform_t *t) {
+	if (!lite_engine_gl_transform_is_stale(t)) {
+		__atomic_fetch_add(&internal_transform_stats.reused, 1, __ATOMIC_RELAXED);
+		return 0;
+	}
+	lite_engine_gl_transform_calculate_matrix(t);
+	__atomic_fetch_add(&internal_transform_stats.recomputed, 1, __ATOMIC_RELAXED);
+	return 1;
+}
+
+// lite_engine_gl_transform_update for many transforms. the dirty ones are
+// gathered into structure of arrays and rebuilt with the SIMD batch kernel.
+void lite_engine_gl_transform_update_batch(transform_t **transforms, size_t count) {
+	transform_batch_t *b = &internal_transform_batch;
+
+	if (count > b->capacity) {
+		b->capacity   = count * 2;
+		b->transforms = realloc(b->transforms, sizeof(*b->transforms) * b->capacity);
+		b->soa        = realloc(b->soa,        sizeof(*b->soa)        * b->capacity * 10);
+		b->matrices   = realloc(b->matrices,   sizeof(*b->matrices)   * b->capacity);
+	}
+
+	float *position_x = b->soa + b->capacity * 0;
+	float *position_y = b->soa + b->capacity * 1;
+	float *position_z = b->soa + b->capacity * 2;
+	float *rotation_w = b->soa + b->capacity * 3;
+	float *rotation_x = b->soa + b->capacity * 4;
+	float *rotation_y = b->soa + b->capacity * 5;
+	float *rotation_z = b->soa + b->capacity * 6;
+	float *scale_x    = b->soa + b->capacity * 7;
+	float *scale_y    = b->soa + b->capacity * 8;
+	float *scale_z    = b->soa + b->capacity * 9;
+
+	size_t dirty = 0;
+	for (size_t i = 0; i < count; i++) {
+		transform_t *t = transforms[i];
+		if (!lite_engine_gl_transform_is_stale(t)) {
+			continue;
+		}
+		vector3_t    position;
+		quaternion_t rotation;
+		vector3_t    scale;
+		internal_transform_blend(t, internal_transform_alpha, &position, &rotation, &scale);
+
+		b->transforms[dirty] = t;
+		position_x[dirty]    = position.x;
+		position_y[dirty]    = position.y;
+		position_z[dirty]    = position.z;
+		rotation_w[dirty]    = rotation.w;
+		rotation_x[dirty]    = rotation.x;
+		rotation_y[dirty]    = rotation.y;
+		rotation_z[dirty]    = rotation.z;
+		scale_x[dirty]       = scale.x;
+		scale_y[dirty]       = scale.y;
+		scale_z[dirty]       = scale.z;
+		dirty++;
+	}
+
+	lite_engine_gl_transform_soa_t soa = {
+		position_x, position_y, position_z,
+		rotation_w, rotation_x, rotation_y, rotation_z,
+		scale_x, scale_y, scale_z,
+	};
+	lite_engine_gl_transform_batch_calculate_matrices(&soa, b->matrices, dirty);
+
+	for (size_t i = 0; i < dirty; i++) {
+		transform_t *t   = b->transforms[i];
+		vector3_t    scale = {
+			scale_x[i], scale_y[i], scale_z[i],
+		};
+		t->matrix        = b->matrices[i];
+		t->normal_matrix = internal_transform_normal_matrix_trs(&t->matrix, scale);
+		t->matrix_alpha  = internal_transform_alpha;
+		t->matrix_valid  = 1;
+	}
+
+	internal_transform_stats.recomputed += dirty;
+	internal_transform_stats.reused     += count - dirty;
+}
+
+void lite_engine_gl_transform_mark_dirty(transform_t *t) {
+	t->version++;
+	t->matrix_valid = 0;
+}
+
+void lite_engine_gl_transform_set_position(transform_t *t, vector3_t position) {
+	t->position = position;
+	lite_engine_gl_transform_mark_dirty(t);
+}
+
+void lite_engine_gl_transform_set_rotation(transform_t *t, quaternion_t rotation) {
+	t->rotation = rotation;
+	lite_engine_gl_transform_mark_dirty(t);
+}
+
+void lite_engine_gl_transform_set_scale(transform_t *t, vector3_t scale) {
+	t->scale = scale;
+	lite_engine_gl_transform_mark_dirty(t);
+}
+
+// records the current state as the one interpolated from. called at the
+// start of every fixed step, before the simulation moves anything.
+void lite_engine_gl_transform_snapshot(transform_t *t) {
+	if (t->previous_valid && !internal_transform_is_moving(t)) {
+		return;
+	}
+	if (t->previous_valid) { // the cache blends a state that is gone now
+		t->matrix_valid = 0;
+	}
+	t->previous_position = t->position;
+	t->previous_rotation = t->rotation;
+	t->previous_scale    = t->scale;
+	t->previous_valid    = 1;
+}
+
+// how far rendering is between the previous and the current state of every
+// transform, from 0 to 1. caches built with another alpha are rebuilt for
+// transforms that moved.
+void lite_engine_gl_transform_set_interpolation(float alpha) {
+	internal_transform_alpha = alpha;
+}
+
+void lite_engine_gl_transform_stats_reset(void) {
+	internal_transform_stats = (lite_engine_gl_transform_stats_t){0};
+}
+
+// recomputed versus reused matrices since the last
+// lite_engine_gl_transform_stats_reset, which happens once per frame.
+lite_engine_gl_transform_stats_t lite_engine_gl_transform_get_stats(void) {
+	return internal_transform_stats;
+}
+
+// the view matrix of a camera at 't', blended by 'alpha' like model
+// matrices. only reads the position, rotation and scale of 't', never the
+// matrix caches, so it can run while the transform stage rebuilds those.
+matrix4_t lite_engine_gl_transform_view_matrix(const transform_t *t, float alpha) {
+	vector3_t    blend_position;
+	quaternion_t blend_rotation;
+	vector3_t    blend_scale;
+	internal_transform_blend(t, alpha, &blend_position, &blend_rotation, &blend_scale);
+
+	matrix4_t translation = matrix4_translate(vector3_negate(blend_position));
+	matrix4_t rotation = quaternion_to_matrix4(quaternion_conjugate(blend_rotation));
+	matrix4_t scale = matrix4_scale(blend_scale);
+	matrix4_t view = matrix4_multiply(translation, rotation);
+	return matrix4_multiply(scale, view);
+}
+
+// inverse transpose of the upper 3x3 of 'm'. transforms normals correctly
+// under non-uniform scale and shear. the inverse transpose is the cofactor
+// matrix divided by the determinant, and the cofactor columns are cross
+// products of the other two columns.
+matrix3_t lite_engine_gl_transform_normal_matrix(const matrix4_t *m) {
+	const float *e = m->elements;
+	matrix3_t    n;
+
+#if defined(__SSE2__)
+	// columns of the upper 3x3, w lanes are garbage and never stored
+	__m128 c0 = _mm_loadu_ps(&e[0]);
+	__m128 c1 = _mm_loadu_ps(&e[4]);
+	__m128 c2 = _mm_loadu_ps(&e[8]);
+
+	// cross(a, b) = a.yzx * b.zxy - a.zxy * b.yzx
+#define TRANSFORM_YZX(v) _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 0, 2, 1))
+#define TRANSFORM_ZXY(v) _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 1, 0, 2))
+#define TRANSFORM_CROSS(a, b) _mm_sub_ps( \
+		_mm_mul_ps(TRANSFORM_YZX(a), TRANSFORM_ZXY(b)), \
+		_mm_mul_ps(TRANSFORM_ZXY(a), TRANSFORM_YZX(b)))
+
+	__m128 r0 = TRANSFORM_CROSS(c1, c2);
+	__m128 r1 = TRANSFORM_CROSS(c2, c0);
+	__m128 r2 = TRANSFORM_CROSS(c0, c1);
+
+#undef TRANSFORM_CROSS
+#undef TRANSFORM_ZXY
+#undef TRANSFORM_YZX
+
+	__m128 d = _mm_mul_ps(c0, r0);
+	float  determinant = _mm_cvtss_f32(d) +
+		_mm_cvtss_f32(_mm_shuffle_ps(d, d, _MM_SHUFFLE(1, 1, 1, 1))) +
+		_mm_cvtss_f32(_mm_shuffle_ps(d, d, _MM_SHUFFLE(2, 2, 2, 2)));
+	__m128 inverse = _mm_set1_ps(determinant != 0.0f ? 1.0f / determinant : 0.0f);
+
+	float columns[3][4];
+	_mm_storeu_ps(columns[0], _mm_mul_ps(r0, inverse));
+	_mm_storeu_ps(columns[1], _mm_mul_ps(r1, inverse));
+	_mm_storeu_ps(columns[2], _mm_mul_ps(r2, inverse));
+	for (int c = 0; c < 3; c++) {
+		n.elements[c * 3 + 0] = columns[c][0];
+		n.elements[c * 3 + 1] = columns[c][1];
+		n.elements[c * 3 + 2] = columns[c][2];
+	}
+#else
+	vector3_t c0 = { e[0], e[1], e[2]  };
+	vector3_t c1 = { e[4], e[5], e[6]  };
+	vector3_t c2 = { e[8], e[9], e[10] };
+
+	vector3_t r0 = vector3_cross(c1, c2);
+	vector3_t r1 = vector3_cross(c2, c0);
+	vector3_t r2 = vector3_cross(c0, c1);
+
+	float determinant = vector3_dot(c0, r0);
+	float inverse     = determinant != 0.0f ? 1.0f / determinant : 0.0f;
+
+	vector3_t columns[3] = {
+		vector3_scale(r0, inverse),
+		vector3_scale(r1, inverse),
+		vector3_scale(r2, inverse),
+	};
+	for (int c = 0; c < 3; c++) {
+		n.elements[c * 3 + 0] = columns[c].x;
+		n.elements[c * 3 + 1] = columns[c].y;
+		n.elements[c * 3 + 2] = columns[c].z;
+	}
+#endif
+
+	return n;
+}
+
+// normal matrix of a TRS matrix 'm' built with 'scale'. with a uniform
+// scale s the upper 3x3 is R * s and its inverse transpose is R / s, which
+// is the upper 3x3 divided by s * s. anything else takes the full inverse.
+static matrix3_t internal_transform_normal_matrix_trs(const matrix4_t *m, vector3_t scale) {
+	if (scale.x != scale.y || scale.x != scale.z || scale.x == 0.0f) {
+		return lite_engine_gl_transform_normal_matrix(m);
+	}
+
+	const float *e       = m->elements;
+	float        inverse = 1.0f / (scale.x * scale.x);
+
+	return (matrix3_t) {
+		.elements = {
+			e[0] * inverse, e[1] * inverse, e[2]  * inverse,
+			e[4] * inverse, e[5] * inverse, e[6]  * inverse,
+			e[8] * inverse, e[9] * inverse, e[10] * inverse,
+		}
+	};
 }
 
 vector3_t transform_basis_forward(transform_t t, float magnitude) {
@@ -0,0 +1,267 @@
+#include "lite_engine_gl.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define TRANSFORM_BATCH_X86 1
+#endif
+
+// builds model matrices straight from structure of arrays position,
+// rotation and scale. the matrix is T * R * S written out by hand, which
+// gives the same result as lite_engine_gl_transform_calculate_matrix
+// without building three matrices and multiplying them.
+//
+// column major:
+//   | (1-2(yy+zz))sx   2(xy-zw)sy     2(xz+yw)sz     px |
+//   | 2(xy+zw)sx       (1-2(xx+zz))sy 2(yz-xw)sz     py |
+//   | 2(xz-yw)sx       2(yz+xw)sy     (1-2(xx+yy))sz pz |
+//   | 0                0              0              1  |
+
+typedef void (*transform_batch_kernel_t)(
+		const lite_engine_gl_transform_soa_t *soa,
+		matrix4_t                            *matrices,
+		size_t                                begin,
+		size_t                                end);
+
+static void internal_transform_batch_scalar(
+		const lite_engine_gl_transform_soa_t *soa,
+		matrix4_t                            *matrices,
+		size_t                                begin,
+		size_t                                end) {
+	for (size_t i = begin; i < end; i++) {
+		float x = soa->rotation_x[i];
+		float y = soa->rotation_y[i];
+		float z = soa->rotation_z[i];
+		float w = soa->rotation_w[i];
+
+		float xx = x * x, xy = x * y, xz = x * z, xw = x * w;
+		float yy = y * y, yz = y * z, yw = y * w;
+		float zz = z * z, zw = z * w;
+
+		float sx = soa->scale_x[i];
+		float sy = soa->scale_y[i];
+		float sz = soa->scale_z[i];
+
+		float *m = matrices[i].elements;
+		m[0]  = (1 - 2 * (yy + zz)) * sx;
+		m[1]  =      2 * (xy + zw)  * sx;
+		m[2]  =      2 * (xz - yw)  * sx;
+		m[3]  = 0;
+		m[4]  =      2 * (xy - zw)  * sy;
+		m[5]  = (1 - 2 * (xx + zz)) * sy;
+		m[6]  =      2 * (yz + xw)  * sy;
+		m[7]  = 0;
+		m[8]  =      2 * (xz + yw)  * sz;
+		m[9]  =      2 * (yz - xw)  * sz;
+		m[10] = (1 - 2 * (xx + yy)) * sz;
+		m[11] = 0;
+		m[12] = soa->position_x[i];
+		m[13] = soa->position_y[i];
+		m[14] = soa->position_z[i];
+		m[15] = 1;
+	}
+}
+
+#if defined(TRANSFORM_BATCH_X86)
+
+// four transforms at a time. every register holds one matrix element for
+// four transforms, groups of four elements are transposed on the way out.
+static void internal_transform_batch_sse(
+		const lite_engine_gl_transform_soa_t *soa,
+		matrix4_t                            *matrices,
+		size_t                                begin,
+		size_t                                end) {
+	size_t i = begin;
+	for (; i + 4 <= end; i += 4) {
+		__m128 x = _mm_loadu_ps(&soa->rotation_x[i]);
+		__m128 y = _mm_loadu_ps(&soa->rotation_y[i]);
+		__m128 z = _mm_loadu_ps(&soa->rotation_z[i]);
+		__m128 w = _mm_loadu_ps(&soa->rotation_w[i]);
+
+		__m128 two = _mm_set1_ps(2.0f);
+		__m128 one = _mm_set1_ps(1.0f);
+
+		__m128 xx = _mm_mul_ps(x, x), xy = _mm_mul_ps(x, y), xz = _mm_mul_ps(x, z), xw = _mm_mul_ps(x, w);
+		__m128 yy = _mm_mul_ps(y, y), yz = _mm_mul_ps(y, z), yw = _mm_mul_ps(y, w);
+		__m128 zz = _mm_mul_ps(z, z), zw = _mm_mul_ps(z, w);
+
+		__m128 sx = _mm_loadu_ps(&soa->scale_x[i]);
+		__m128 sy = _mm_loadu_ps(&soa->scale_y[i]);
+		__m128 sz = _mm_loadu_ps(&soa->scale_z[i]);
+
+		__m128 columns[4][4] = {
+			{
+				_mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), sx),
+				_mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, zw)), sx),
+				_mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, yw)), sx),
+				_mm_setzero_ps(),
+			},
+			{
+				_mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, zw)), sy),
+				_mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), sy),
+				_mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, xw)), sy),
+				_mm_setzero_ps(),
+			},
+			{
+				_mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, yw)), sz),
+				_mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, xw)), sz),
+				_mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), sz),
+				_mm_setzero_ps(),
+			},
+			{
+				_mm_loadu_ps(&soa->position_x[i]),
+				_mm_loadu_ps(&soa->position_y[i]),
+				_mm_loadu_ps(&soa->position_z[i]),
+				one,
+			},
+		};
+
+		for (int c = 0; c < 4; c++) {
+			_MM_TRANSPOSE4_PS(columns[c][0], columns[c][1], columns[c][2], columns[c][3]);
+			for (int lane = 0; lane < 4; lane++) {
+				_mm_storeu_ps(&matrices[i + lane].elements[c * 4], columns[c][lane]);
+			}
+		}
+	}
+
+	internal_transform_batch_scalar(soa, matrices, i, end);
+}
+
+// eight transforms at a time, same layout as the SSE kernel. the 8x4
+// transpose is done as two 4x4 transposes, one per 128 bit half.
+__attribute__((target("avx2,fma")))
+static void internal_transform_batch_avx2(
+		const lite_engine_gl_transform_soa_t *soa,
+		matrix4_t                            *matrices,
+		size_t                                begin,
+		size_t                                end) {
+	size_t i = begin;
+	for (; i + 8 <= end; i += 8) {
+		__m256 x = _mm256_loadu_ps(&soa->rotation_x[i]);
+		__m256 y = _mm256_loadu_ps(&soa->rotation_y[i]);
+		__m256 z = _mm256_loadu_ps(&soa->rotation_z[i]);
+		__m256 w = _mm256_loadu_ps(&soa->rotation_w[i]);
+
+		__m256 two = _mm256_set1_ps(2.0f);
+		__m256 one = _mm256_set1_ps(1.0f);
+
+		__m256 xx = _mm256_mul_ps(x, x), xy = _mm256_mul_ps(x, y), xz = _mm256_mul_ps(x, z), xw = _mm256_mul_ps(x, w);
+		__m256 yy = _mm256_mul_ps(y, y), yz = _mm256_mul_ps(y, z), yw = _mm256_mul_ps(y, w);
+		__m256 zz = _mm256_mul_ps(z, z), zw = _mm256_mul_ps(z, w);
+
+		__m256 sx = _mm256_loadu_ps(&soa->scale_x[i]);
+		__m256 sy = _mm256_loadu_ps(&soa->scale_y[i]);
+		__m256 sz = _mm256_loadu_ps(&soa->scale_z[i]);
+
+		__m256 columns[4][4] = {
+			{
+				_mm256_mul_ps(_mm256_fnmadd_ps(two, _mm256_add_ps(yy, zz), one), sx),
+				_mm256_mul_ps(_mm256_mul_ps(two, _mm256_add_ps(xy, zw)), sx),
+				_mm256_mul_ps(_mm256_mul_ps(two, _mm256_sub_ps(xz, yw)), sx),
+				_mm256_setzero_ps(),
+			},
+			{
+				_mm256_mul_ps(_mm256_mul_ps(two, _mm256_sub_ps(xy, zw)), sy),
+				_mm256_mul_ps(_mm256_fnmadd_ps(two, _mm256_add_ps(xx, zz), one), sy),
+				_mm256_mul_ps(_mm256_mul_ps(two, _mm256_add_ps(yz, xw)), sy),
+				_mm256_setzero_ps(),
+			},
+			{
+				_mm256_mul_ps(_mm256_mul_ps(two, _mm256_add_ps(xz, yw)), sz),
+				_mm256_mul_ps(_mm256_mul_ps(two, _mm256_sub_ps(yz, xw)), sz),
+				_mm256_mul_ps(_mm256_fnmadd_ps(two, _mm256_add_ps(xx, yy), one), sz),
+				_mm256_setzero_ps(),
+			},
+			{
+				_mm256_loadu_ps(&soa->position_x[i]),
+				_mm256_loadu_ps(&soa->position_y[i]),
+				_mm256_loadu_ps(&soa->position_z[i]),
+				one,
+			},
+		};
+
+		for (int c = 0; c < 4; c++) {
+			__m256 t0 = _mm256_unpacklo_ps(columns[c][0], columns[c][1]);
+			__m256 t1 = _mm256_unpackhi_ps(columns[c][0], columns[c][1]);
+			__m256 t2 = _mm256_unpacklo_ps(columns[c][2], columns[c][3]);
+			__m256 t3 = _mm256_unpackhi_ps(columns[c][2], columns[c][3]);
+
+			// lane n of each 128 bit half now holds transform n (low half)
+			// or n + 4 (high half)
+			__m256 r0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+			__m256 r1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+			__m256 r2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+			__m256 r3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+
+			_mm_storeu_ps(&matrices[i + 0].elements[c * 4], _mm256_castps256_ps128(r0));
+			_mm_storeu_ps(&matrices[i + 1].elements[c * 4], _mm256_castps256_ps128(r1));
+			_mm_storeu_ps(&matrices[i + 2].elements[c * 4], _mm256_castps256_ps128(r2));
+			_mm_storeu_ps(&matrices[i + 3].elements[c * 4], _mm256_castps256_ps128(r3));
+			_mm_storeu_ps(&matrices[i + 4].elements[c * 4], _mm256_extractf128_ps(r0, 1));
+			_mm_storeu_ps(&matrices[i + 5].elements[c * 4], _mm256_extractf128_ps(r1, 1));
+			_mm_storeu_ps(&matrices[i + 6].elements[c * 4], _mm256_extractf128_ps(r2, 1));
+			_mm_storeu_ps(&matrices[i + 7].elements[c * 4], _mm256_extractf128_ps(r3, 1));
+		}
+	}
+
+	internal_transform_batch_sse(soa, matrices, i, end);
+}
+
+#endif // TRANSFORM_BATCH_X86
+
+static transform_batch_kernel_t internal_transform_batch_kernel = NULL;
+static const char              *internal_transform_batch_kernel_name = "scalar";
+
+static void internal_transform_batch_select(void) {
+	internal_transform_batch_kernel = internal_transform_batch_scalar;
+	internal_transform_batch_kernel_name = "scalar";
+
+#if defined(TRANSFORM_BATCH_X86)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+		internal_transform_batch_kernel = internal_transform_batch_avx2;
+		internal_transform_batch_kernel_name = "avx2";
+	} else if (__builtin_cpu_supports("sse2")) {
+		internal_transform_batch_kernel = internal_transform_batch_sse;
+		internal_transform_batch_kernel_name = "sse";
+	}
+#endif
+}
+
+// selects the widest kernel the cpu supports. called on first use, call it
+// directly to override the choice ("scalar", "sse" or "avx2"). unknown or
+// unsupported names fall back to the automatic choice.
+void lite_engine_gl_transform_batch_use_kernel(const char *name) {
+	internal_transform_batch_select();
+
+	if (name == NULL) {
+		return;
+	}
+
+	if (strcmp(name, "scalar") == 0) {
+		internal_transform_batch_kernel = internal_transform_batch_scalar;
+		internal_transform_batch_kernel_name = "scalar";
+	}
+#if defined(TRANSFORM_BATCH_X86)
+	else if (strcmp(name, "sse") == 0 && __builtin_cpu_supports("sse2")) {
+		internal_transform_batch_kernel = internal_transform_batch_sse;
+		internal_transform_batch_kernel_name = "sse";
+	}
+#endif
+}
+
+const char *lite_engine_gl_transform_batch_kernel_name(void) {
+	if (internal_transform_batch_kernel == NULL) {
+		internal_transform_batch_select();
+	}
+	return internal_transform_batch_kernel_name;
+}
+
+void lite_engine_gl_transform_batch_calculate_matrices(
+		const lite_engine_gl_transform_soa_t *soa,
+		matrix4_t                            *matrices,
+		size_t                                count) {
+	if (internal_transform_batch_kernel == NULL) {
+		internal_transform_batch_select();
+	}
+	internal_transform_batch_kernel(soa, matrices, 0, count);
+}
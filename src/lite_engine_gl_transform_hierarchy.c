@@ -0,0 +1,292 @@
+#include "lite_engine_gl.h"
+
+// transform hierarchy. parent links live in a sparse set keyed by the child.
+// from them a flat node list sorted by depth is built, so every parent comes
+// before its children and world matrices are propagated in one linear pass,
+// one depth level at a time with each level split across the job workers.
+//
+// for a parented transform 'matrix' and 'normal_matrix' hold the world
+// matrices after lite_engine_gl_transform_hierarchy_update. only nodes whose
+// own transform changed, or whose parent's world matrix changed, are
+// recomputed.
+
+#define HIERARCHY_NONE   UINT32_MAX
+#define HIERARCHY_BATCH  256
+
+typedef struct {
+	ui64 entity;
+	ui64 parent;
+	ui32 depth;
+} hierarchy_sort_t;
+
+typedef struct {
+	lite_engine_sparse_set_t *parents;      // child entity -> parent entity
+	lite_engine_sparse_set_t *node_indices; // entity -> node, only valid while building
+	ui8                       structure_dirty;
+
+	ui64                     *entities;     // nodes sorted by depth
+	ui32                     *parent_nodes; // HIERARCHY_NONE for roots
+	matrix4_t                *local;
+	matrix4_t                *world;
+	ui8                      *changed;
+	ui32                      node_count;
+	ui32                      node_capacity;
+
+	ui32                     *level_offsets; // first node of each depth, plus one past the end
+	ui32                      level_count;
+
+	hierarchy_sort_t         *sort;
+	ui32                      sort_capacity;
+} transform_hierarchy_t;
+
+static transform_hierarchy_t internal_hierarchy;
+
+// column major a * b
+static matrix4_t internal_transform_multiply(const matrix4_t *a, const matrix4_t *b) {
+	matrix4_t r;
+	for (int column = 0; column < 4; column++) {
+		for (int row = 0; row < 4; row++) {
+			r.elements[column * 4 + row] =
+				a->elements[0 * 4 + row] * b->elements[column * 4 + 0] +
+				a->elements[1 * 4 + row] * b->elements[column * 4 + 1] +
+				a->elements[2 * 4 + row] * b->elements[column * 4 + 2] +
+				a->elements[3 * 4 + row] * b->elements[column * 4 + 3];
+		}
+	}
+	return r;
+}
+
+// a destroyed parent counts as no parent, its children become roots
+static ui64 internal_hierarchy_parent(ui64 entity) {
+	ui64 *parent = lite_engine_sparse_set_get(internal_hierarchy.parents, entity);
+	if (parent == NULL || !lite_engine_entity_is_alive(*parent)) {
+		return LITE_ENGINE_ENTITY_NONE;
+	}
+	return *parent;
+}
+
+// attaches 'child' to 'parent', or detaches it when 'parent' is
+// LITE_ENGINE_ENTITY_NONE. both need a transform. links that would create a
+// cycle are refused.
+void lite_engine_gl_transform_set_parent(ui64 child, ui64 parent) {
+	transform_hierarchy_t *h = &internal_hierarchy;
+
+	if (h->parents == NULL) {
+		h->parents      = lite_engine_sparse_set_create(sizeof(ui64));
+		h->node_indices = lite_engine_sparse_set_create(sizeof(ui32));
+	}
+
+	if (parent == LITE_ENGINE_ENTITY_NONE) {
+		lite_engine_sparse_set_remove(h->parents, child);
+	} else {
+		for (ui64 e = parent; e != LITE_ENGINE_ENTITY_NONE; e = internal_hierarchy_parent(e)) {
+			if (e == child) {
+				debug_error("refusing to parent an entity to its own descendant");
+				return;
+			}
+		}
+		lite_engine_sparse_set_add(h->parents, child, &parent);
+	}
+
+	transform_t *t = lite_engine_entity_get_component(child,
+			lite_engine_gl_get_components().transform);
+	if (t != NULL) {
+		lite_engine_gl_transform_mark_dirty(t);
+	}
+
+	h->structure_dirty = 1;
+}
+
+ui64 lite_engine_gl_transform_get_parent(ui64 child) {
+	if (internal_hierarchy.parents == NULL) {
+		return LITE_ENGINE_ENTITY_NONE;
+	}
+	return internal_hierarchy_parent(child);
+}
+
+static int internal_hierarchy_compare(const void *a, const void *b) {
+	const hierarchy_sort_t *x = a;
+	const hierarchy_sort_t *y = b;
+	if (x->depth != y->depth) {
+		return x->depth < y->depth ? -1 : 1;
+	}
+	if (x->parent != y->parent) { // keep siblings together
+		return x->parent < y->parent ? -1 : 1;
+	}
+	return x->entity < y->entity ? -1 : (x->entity > y->entity);
+}
+
+static void internal_hierarchy_rebuild(void) {
+	transform_hierarchy_t *h = &internal_hierarchy;
+
+	// drop links to destroyed parents, walking backwards so removal is safe.
+	// the orphan is a root now, its cached matrix still has the parent in it
+	// and no node walk reaches it to clear that.
+	for (ui32 i = h->parents->count; i-- > 0;) {
+		if (!lite_engine_entity_is_alive(((ui64 *)h->parents->components)[i])) {
+			ui64 child = h->parents->dense[i];
+			lite_engine_sparse_set_remove(h->parents, child);
+
+			transform_t *t = lite_engine_entity_get_component(child,
+					lite_engine_gl_get_components().transform);
+			if (t != NULL) {
+				lite_engine_gl_transform_mark_dirty(t);
+			}
+		}
+	}
+
+	// every child plus every root that has children
+	ui32 capacity = h->parents->count * 2;
+	if (capacity > h->sort_capacity) {
+		h->sort_capacity = capacity;
+		h->sort          = realloc(h->sort, sizeof(*h->sort) * h->sort_capacity);
+	}
+
+	ui32 count = 0;
+	for (ui32 i = 0; i < h->parents->count; i++) {
+		ui64 child  = h->parents->dense[i];
+		ui64 parent = ((ui64 *)h->parents->components)[i];
+
+		ui32 depth = 1;
+		ui64 root  = parent;
+		for (ui64 p = internal_hierarchy_parent(parent); p != LITE_ENGINE_ENTITY_NONE;
+				p = internal_hierarchy_parent(p)) {
+			root = p;
+			depth++;
+		}
+
+		h->sort[count++] = (hierarchy_sort_t) { .entity = child, .parent = parent, .depth = depth };
+		if (depth == 1) {
+			h->sort[count++] = (hierarchy_sort_t) { .entity = root, .parent = LITE_ENGINE_ENTITY_NONE };
+		}
+	}
+
+	qsort(h->sort, count, sizeof(*h->sort), internal_hierarchy_compare);
+
+	if (count > h->node_capacity) {
+		h->node_capacity = count * 2;
+		h->entities      = realloc(h->entities,     sizeof(*h->entities)     * h->node_capacity);
+		h->parent_nodes  = realloc(h->parent_nodes, sizeof(*h->parent_nodes) * h->node_capacity);
+		h->local         = realloc(h->local,        sizeof(*h->local)        * h->node_capacity);
+		h->world         = realloc(h->world,        sizeof(*h->world)        * h->node_capacity);
+		h->changed       = realloc(h->changed,      sizeof(*h->changed)      * h->node_capacity);
+		h->level_offsets = realloc(h->level_offsets, sizeof(*h->level_offsets) * (h->node_capacity + 1));
+	}
+
+	lite_engine_sparse_set_clear(h->node_indices);
+	lite_engine_component_t transform = lite_engine_gl_get_components().transform;
+
+	h->node_count  = 0;
+	h->level_count = 0;
+	for (ui32 i = 0; i < count; i++) {
+		if (i > 0 && h->sort[i].entity == h->sort[i - 1].entity) { // root shared by siblings
+			continue;
+		}
+
+		ui32 node = h->node_count++;
+		h->entities[node]     = h->sort[i].entity;
+		h->parent_nodes[node] = HIERARCHY_NONE;
+		if (h->sort[i].parent != LITE_ENGINE_ENTITY_NONE) {
+			h->parent_nodes[node] = *(ui32 *)lite_engine_sparse_set_get(h->node_indices, h->sort[i].parent);
+		}
+		lite_engine_sparse_set_add(h->node_indices, h->sort[i].entity, &node);
+
+		while (h->level_count <= h->sort[i].depth) {
+			h->level_offsets[h->level_count++] = node;
+		}
+
+		// the cached local and world matrices are gone, rebuild everything once
+		transform_t *t = lite_engine_entity_get_component(h->entities[node], transform);
+		if (t != NULL) {
+			t->matrix_valid = 0;
+		}
+	}
+	h->level_offsets[h->level_count] = h->node_count;
+
+	h->structure_dirty = 0;
+}
+
+// 'data' is the first node of the level, begin and end are relative to it
+static void internal_hierarchy_level_job(void *data, ui32 begin, ui32 end) {
+	transform_hierarchy_t  *h         = &internal_hierarchy;
+	lite_engine_component_t transform = lite_engine_gl_get_components().transform;
+	ui32                    level     = (ui32)(uintptr_t)data;
+
+	for (ui32 node = level + begin; node < level + end; node++) {
+		transform_t *t      = lite_engine_entity_get_component(h->entities[node], transform);
+		ui32         parent = h->parent_nodes[node];
+
+		if (t == NULL) { // no transform, pass the parent's world matrix through
+			h->world[node]   = parent == HIERARCHY_NONE ? matrix4_identity() : h->world[parent];
+			h->changed[node] = parent == HIERARCHY_NONE ? 0 : h->changed[parent];
+			continue;
+		}
+
+		if (parent == HIERARCHY_NONE) {
+			h->changed[node] = lite_engine_gl_transform_update(t);
+			h->world[node]   = t->matrix;
+			continue;
+		}
+
+		ui8 local_changed = lite_engine_gl_transform_is_stale(t);
+		if (local_changed) {
+			lite_engine_gl_transform_calculate_matrix(t);
+			h->local[node] = t->matrix;
+		}
+
+		h->changed[node] = local_changed || h->changed[parent];
+		if (h->changed[node]) {
+			h->world[node]   = internal_transform_multiply(&h->world[parent], &h->local[node]);
+			t->matrix        = h->world[node];
+			t->normal_matrix = lite_engine_gl_transform_normal_matrix(&h->world[node]);
+			t->matrix_valid  = 1;
+		}
+	}
+}
+
+// propagates world matrices down the hierarchy. call once per frame after
+// gameplay moved things and before rendering.
+void lite_engine_gl_transform_hierarchy_update(void) {
+	transform_hierarchy_t *h = &internal_hierarchy;
+
+	if (h->parents == NULL) {
+		return;
+	}
+
+	if (!h->structure_dirty) { // entities destroyed since the last rebuild
+		for (ui32 node = 0; node < h->node_count; node++) {
+			if (!lite_engine_entity_is_alive(h->entities[node])) {
+				h->structure_dirty = 1;
+				break;
+			}
+		}
+	}
+
+	if (h->structure_dirty) {
+		internal_hierarchy_rebuild();
+	}
+
+	for (ui32 level = 0; level < h->level_count; level++) {
+		ui32 begin = h->level_offsets[level];
+		ui32 end   = h->level_offsets[level + 1];
+		lite_engine_job_parallel_for(end - begin, HIERARCHY_BATCH,
+				internal_hierarchy_level_job, (void *)(uintptr_t)begin);
+	}
+}
+
+void lite_engine_gl_transform_hierarchy_free(void) {
+	transform_hierarchy_t *h = &internal_hierarchy;
+
+	if (h->parents != NULL) {
+		lite_engine_sparse_set_free(h->parents);
+		lite_engine_sparse_set_free(h->node_indices);
+	}
+	free(h->entities);
+	free(h->parent_nodes);
+	free(h->local);
+	free(h->world);
+	free(h->changed);
+	free(h->level_offsets);
+	free(h->sort);
+	*h = (transform_hierarchy_t) {0};
+}
@@ -0,0 +1,108 @@
+#include "lite_engine_gl.h"
+
+// std140 mirrors of the uniform blocks declared in the shaders. keep these
+// in sync with res/shaders/*.glsl. every vector3_t is followed by a scalar
+// so that the next member lands on a 16 byte boundary.
+typedef struct {
+	matrix4_t      view;
+	matrix4_t      projection;
+	vector3_t      camera_position;
+	float          padding;
+} uniform_buffer_frame_t;
+
+typedef struct {
+	vector3_t      position;
+	float          constant;
+	vector3_t      direction;
+	float          linear;
+	vector3_t      diffuse;
+	float          quadratic;
+	vector3_t      specular;
+	float          cut_off;
+	float          outer_cut_off;
+	int32_t        type;
+	float          padding[2];
+} uniform_buffer_light_t;
+
+typedef struct {
+	uniform_buffer_light_t light;
+	vector3_t              ambient;
+	float                  padding;
+} uniform_buffer_lights_t;
+
+static const char *internal_uniform_buffer_block_names[LITE_ENGINE_GL_UNIFORM_BUFFER_COUNT] = {
+	[LITE_ENGINE_GL_UNIFORM_BUFFER_FRAME]  = "lite_engine_frame",
+	[LITE_ENGINE_GL_UNIFORM_BUFFER_LIGHTS] = "lite_engine_lights",
+};
+
+static const GLsizeiptr internal_uniform_buffer_sizes[LITE_ENGINE_GL_UNIFORM_BUFFER_COUNT] = {
+	[LITE_ENGINE_GL_UNIFORM_BUFFER_FRAME]  = sizeof(uniform_buffer_frame_t),
+	[LITE_ENGINE_GL_UNIFORM_BUFFER_LIGHTS] = sizeof(uniform_buffer_lights_t),
+};
+
+static GLuint internal_uniform_buffers[LITE_ENGINE_GL_UNIFORM_BUFFER_COUNT];
+
+void lite_engine_gl_uniform_buffer_start(void) {
+	glGenBuffers(LITE_ENGINE_GL_UNIFORM_BUFFER_COUNT, internal_uniform_buffers);
+
+	for (ui32 i = 0; i < LITE_ENGINE_GL_UNIFORM_BUFFER_COUNT; i++) {
+		lite_engine_gl_state_bind_buffer(GL_UNIFORM_BUFFER, internal_uniform_buffers[i]);
+		glBufferData(GL_UNIFORM_BUFFER, internal_uniform_buffer_sizes[i], NULL, GL_DYNAMIC_DRAW);
+
+		// binding points are fixed, programs are pointed at them in
+		// lite_engine_gl_uniform_buffer_bind_program
+		lite_engine_gl_state_bind_buffer_base(GL_UNIFORM_BUFFER, i, internal_uniform_buffers[i]);
+	}
+}
+
+void lite_engine_gl_uniform_buffer_stop(void) {
+	lite_engine_gl_state_bind_buffer(GL_UNIFORM_BUFFER, 0);
+	glDeleteBuffers(LITE_ENGINE_GL_UNIFORM_BUFFER_COUNT, internal_uniform_buffers);
+	memset(internal_uniform_buffers, 0, sizeof(internal_uniform_buffers));
+}
+
+// GLSL 4.1 has no layout(binding = n) for blocks, so each program has its
+// blocks pointed at the fixed binding points once after linking.
+void lite_engine_gl_uniform_buffer_bind_program(GLuint program) {
+	for (ui32 i = 0; i < LITE_ENGINE_GL_UNIFORM_BUFFER_COUNT; i++) {
+		GLuint block = glGetUniformBlockIndex(program, internal_uniform_buffer_block_names[i]);
+		if (block != GL_INVALID_INDEX) {
+			glUniformBlockBinding(program, block, i);
+		}
+	}
+}
+
+static void internal_uniform_buffer_upload(ui32 buffer, const void *data) {
+	lite_engine_gl_state_bind_buffer(GL_UNIFORM_BUFFER, internal_uniform_buffers[buffer]);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, internal_uniform_buffer_sizes[buffer], data);
+}
+
+void lite_engine_gl_uniform_buffer_update_frame(
+		matrix4_t *view,
+		matrix4_t *projection,
+		vector3_t  camera_position) {
+	uniform_buffer_frame_t frame = {
+		.view            = *view,
+		.projection      = *projection,
+		.camera_position = camera_position,
+	};
+	internal_uniform_buffer_upload(LITE_ENGINE_GL_UNIFORM_BUFFER_FRAME, &frame);
+}
+
+void lite_engine_gl_uniform_buffer_update_lights(
+		vector3_t      light_position,
+		point_light_t *light,
+		vector3_t      ambient) {
+	uniform_buffer_lights_t lights = {
+		.light = {
+			.position  = light_position,
+			.constant  = light->constant,
+			.linear    = light->linear,
+			.quadratic = light->quadratic,
+			.diffuse   = light->diffuse,
+			.specular  = light->specular,
+		},
+		.ambient = ambient,
+	};
+	internal_uniform_buffer_upload(LITE_ENGINE_GL_UNIFORM_BUFFER_LIGHTS, &lights);
+}
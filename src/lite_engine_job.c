@@ -0,0 +1,500 @@
+#include "lite_engine.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+#include <unistd.h>
+
+// work stealing job pool. every worker, and the thread that called
+// lite_engine_job_start, owns a Chase-Lev deque: it pushes and pops at the
+// bottom without locking while idle threads steal from the top. threads
+// outside the pool submit through a small locked queue instead. workers that
+// find nothing spin for a moment, then sleep until the next submit.
+// with zero workers every job runs inline on the thread that submits it.
+//
+// the deque follows "Correct and Efficient Work-Stealing for Weak Memory
+// Models" (Le, Pop, Cohen, Zappa Nardelli, 2013), with its fences folded into
+// seq_cst accesses. on x86 that costs the same and the thread sanitizer can
+// follow it.
+
+#define JOB_CACHE_LINE        64
+#define JOB_DEQUE_INITIAL     256
+#define JOB_SPIN_BEFORE_SLEEP 64
+
+typedef struct {
+	lite_engine_job_function_t  function;
+	void                       *data;
+	lite_engine_job_counter_t  *counter;
+} job_t;
+
+typedef struct job_array {
+	int64_t           size;    // power of two
+	job_t            *jobs;
+	struct job_array *retired; // the smaller array this one replaced, thieves may still read it
+} job_array_t;
+
+typedef struct {
+	int64_t      top    __attribute__((aligned(JOB_CACHE_LINE))); // atomic, thieves take from here
+	int64_t      bottom __attribute__((aligned(JOB_CACHE_LINE))); // atomic, the owner pushes and pops here
+	job_array_t *array  __attribute__((aligned(JOB_CACHE_LINE))); // atomic
+} job_deque_t;
+
+typedef struct {
+	pthread_t       *threads;
+	ui32             worker_count;
+	ui8              running; // atomic
+
+	job_deque_t     *deques;  // [0] belongs to the starting thread, [i + 1] to worker i
+	ui32             deque_count;
+
+	pthread_mutex_t  external_mutex;
+	job_t           *external;
+	ui32             external_head;
+	ui32             external_count; // atomic for the unlocked emptiness check
+	ui32             external_capacity;
+
+	ui32             pending;  // submitted jobs nobody took yet, atomic
+	ui32             sleepers; // atomic
+	pthread_mutex_t  sleep_mutex;
+	pthread_cond_t   wake;
+} job_pool_t;
+
+static job_pool_t internal_job_pool = {
+	.external_mutex = PTHREAD_MUTEX_INITIALIZER,
+	.sleep_mutex    = PTHREAD_MUTEX_INITIALIZER,
+	.wake           = PTHREAD_COND_INITIALIZER,
+};
+
+static __thread int  internal_job_deque_index = -1; // -1 outside the pool
+static __thread ui32 internal_job_random;
+
+static job_array_t *internal_job_array_create(int64_t size) {
+	job_array_t *a = malloc(sizeof(*a));
+	a->size    = size;
+	a->jobs    = malloc(sizeof(*a->jobs) * size);
+	a->retired = NULL;
+	return a;
+}
+
+// thieves read slots while the owner writes others, so every field goes
+// through relaxed atomics. top and bottom order them.
+static void internal_job_slot_store(job_array_t *a, int64_t i, job_t job) {
+	job_t *slot = &a->jobs[i & (a->size - 1)];
+	__atomic_store_n(&slot->function, job.function, __ATOMIC_RELAXED);
+	__atomic_store_n(&slot->data,     job.data,     __ATOMIC_RELAXED);
+	__atomic_store_n(&slot->counter,  job.counter,  __ATOMIC_RELAXED);
+}
+
+static job_t internal_job_slot_load(job_array_t *a, int64_t i) {
+	job_t *slot = &a->jobs[i & (a->size - 1)];
+	return (job_t) {
+		.function = __atomic_load_n(&slot->function, __ATOMIC_RELAXED),
+		.data     = __atomic_load_n(&slot->data,     __ATOMIC_RELAXED),
+		.counter  = __atomic_load_n(&slot->counter,  __ATOMIC_RELAXED),
+	};
+}
+
+// owner only
+static void internal_job_deque_push(job_deque_t *d, job_t job) {
+	int64_t      b = __atomic_load_n(&d->bottom, __ATOMIC_RELAXED);
+	int64_t      t = __atomic_load_n(&d->top,    __ATOMIC_ACQUIRE);
+	job_array_t *a = __atomic_load_n(&d->array,  __ATOMIC_RELAXED);
+
+	if (b - t > a->size - 1) {
+		job_array_t *grown = internal_job_array_create(a->size * 2);
+		for (int64_t i = t; i < b; i++) {
+			internal_job_slot_store(grown, i, internal_job_slot_load(a, i));
+		}
+		grown->retired = a;
+		__atomic_store_n(&d->array, grown, __ATOMIC_RELEASE);
+		a = grown;
+	}
+
+	internal_job_slot_store(a, b, job);
+	__atomic_store_n(&d->bottom, b + 1, __ATOMIC_RELEASE);
+}
+
+// owner only, returns 0 when the deque is empty
+static ui8 internal_job_deque_pop(job_deque_t *d, job_t *job) {
+	int64_t      b = __atomic_load_n(&d->bottom, __ATOMIC_RELAXED) - 1;
+	job_array_t *a = __atomic_load_n(&d->array,  __ATOMIC_RELAXED);
+	__atomic_store_n(&d->bottom, b, __ATOMIC_SEQ_CST);
+	int64_t      t = __atomic_load_n(&d->top,    __ATOMIC_SEQ_CST);
+
+	if (t > b) {
+		__atomic_store_n(&d->bottom, b + 1, __ATOMIC_RELAXED);
+		return 0;
+	}
+
+	*job = internal_job_slot_load(a, b);
+	if (t != b) {
+		return 1;
+	}
+
+	// the last job, thieves may be after it too
+	ui8 won = __atomic_compare_exchange_n(&d->top, &t, t + 1, 0, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+	__atomic_store_n(&d->bottom, b + 1, __ATOMIC_RELAXED);
+	return won;
+}
+
+// any thread, returns 0 when the deque is empty or another thread got there first
+static ui8 internal_job_deque_steal(job_deque_t *d, job_t *job) {
+	int64_t t = __atomic_load_n(&d->top,    __ATOMIC_SEQ_CST);
+	int64_t b = __atomic_load_n(&d->bottom, __ATOMIC_SEQ_CST);
+
+	if (t >= b) {
+		return 0;
+	}
+
+	job_array_t *a = __atomic_load_n(&d->array, __ATOMIC_ACQUIRE);
+	*job = internal_job_slot_load(a, t);
+	return __atomic_compare_exchange_n(&d->top, &t, t + 1, 0, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+}
+
+static void internal_job_deque_free(job_deque_t *d) {
+	job_array_t *a = d->array;
+	while (a != NULL) {
+		job_array_t *retired = a->retired;
+		free(a->jobs);
+		free(a);
+		a = retired;
+	}
+	d->array = NULL;
+}
+
+// xorshift, spreads thieves over the victims
+static ui32 internal_job_random_next(void) {
+	ui32 x = internal_job_random;
+	if (x == 0) {
+		x = (ui32)(uintptr_t)&internal_job_random | 1;
+	}
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	internal_job_random = x;
+	return x;
+}
+
+static ui8 internal_job_take_external(job_t *job) {
+	job_pool_t *p = &internal_job_pool;
+
+	if (__atomic_load_n(&p->external_count, __ATOMIC_RELAXED) == 0) {
+		return 0;
+	}
+
+	ui8 found = 0;
+	pthread_mutex_lock(&p->external_mutex);
+	if (p->external_count > 0) {
+		*job             = p->external[p->external_head];
+		p->external_head = (p->external_head + 1) % p->external_capacity;
+		__atomic_store_n(&p->external_count, p->external_count - 1, __ATOMIC_RELAXED);
+		found = 1;
+	}
+	pthread_mutex_unlock(&p->external_mutex);
+
+	return found;
+}
+
+// the own deque first (newest job, still warm in cache), then the external
+// queue, then the oldest job of some other thread
+static ui8 internal_job_find(job_t *job) {
+	job_pool_t *p    = &internal_job_pool;
+	int         self = internal_job_deque_index;
+
+	if (self >= 0 && internal_job_deque_pop(&p->deques[self], job)) {
+		return 1;
+	}
+
+	if (internal_job_take_external(job)) {
+		return 1;
+	}
+
+	ui32 start = internal_job_random_next();
+	for (ui32 i = 0; i < p->deque_count; i++) {
+		ui32 victim = (start + i) % p->deque_count;
+		if ((int)victim != self && internal_job_deque_steal(&p->deques[victim], job)) {
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+static void internal_job_execute(job_t job) {
+	__atomic_sub_fetch(&internal_job_pool.pending, 1, __ATOMIC_RELAXED);
+
+	job.function(job.data);
+
+	if (job.counter != NULL) {
+		__atomic_sub_fetch(&job.counter->value, 1, __ATOMIC_RELEASE);
+	}
+}
+
+// runs one queued job on the calling thread, returns 0 if there was none.
+ui8 lite_engine_job_run_one(void) {
+	job_t job;
+	if (!internal_job_find(&job)) {
+		return 0;
+	}
+	internal_job_execute(job);
+	return 1;
+}
+
+static void *internal_job_worker(void *argument) {
+	job_pool_t *p = &internal_job_pool;
+
+	internal_job_deque_index = (int)(uintptr_t)argument;
+
+	ui32 idle = 0;
+	while (__atomic_load_n(&p->running, __ATOMIC_ACQUIRE)) {
+		if (lite_engine_job_run_one()) {
+			idle = 0;
+			continue;
+		}
+
+		if (++idle < JOB_SPIN_BEFORE_SLEEP) {
+			sched_yield();
+			continue;
+		}
+
+		// submit bumps pending before it looks at sleepers, so either this
+		// sees the job or the submitter sees this thread and signals it
+		pthread_mutex_lock(&p->sleep_mutex);
+		__atomic_add_fetch(&p->sleepers, 1, __ATOMIC_SEQ_CST);
+		while (__atomic_load_n(&p->pending, __ATOMIC_SEQ_CST) == 0 &&
+				__atomic_load_n(&p->running, __ATOMIC_ACQUIRE)) {
+			pthread_cond_wait(&p->wake, &p->sleep_mutex);
+		}
+		__atomic_sub_fetch(&p->sleepers, 1, __ATOMIC_SEQ_CST);
+		pthread_mutex_unlock(&p->sleep_mutex);
+		idle = 0;
+	}
+
+	while (lite_engine_job_run_one()) {
+	}
+
+	return NULL;
+}
+
+// starts 'worker_count' worker threads. LITE_ENGINE_JOB_WORKERS_AUTO uses one
+// per core, minus the calling thread, which takes part through
+// lite_engine_job_wait and lite_engine_job_parallel_for.
+void lite_engine_job_start(ui32 worker_count) {
+	job_pool_t *p = &internal_job_pool;
+
+	if (worker_count == LITE_ENGINE_JOB_WORKERS_AUTO) {
+		long cores   = sysconf(_SC_NPROCESSORS_ONLN);
+		worker_count = cores > 1 ? (ui32)cores - 1 : 0;
+	}
+
+	p->deque_count = worker_count + 1;
+	if (posix_memalign((void **)&p->deques, JOB_CACHE_LINE, sizeof(*p->deques) * p->deque_count) != 0) {
+		debug_error("failed to allocate %u job deques", p->deque_count);
+		assert(0);
+	}
+	memset(p->deques, 0, sizeof(*p->deques) * p->deque_count);
+	for (ui32 i = 0; i < p->deque_count; i++) {
+		p->deques[i].array = internal_job_array_create(JOB_DEQUE_INITIAL);
+	}
+	internal_job_deque_index = 0;
+
+	p->pending      = 0;
+	p->sleepers     = 0;
+	p->running      = 1;
+	p->worker_count = worker_count;
+	p->threads      = calloc(worker_count + 1, sizeof(*p->threads));
+
+	for (ui32 i = 0; i < worker_count; i++) {
+		if (pthread_create(&p->threads[i], NULL, internal_job_worker, (void *)(uintptr_t)(i + 1)) != 0) {
+			debug_error("failed to create job worker thread %u", i);
+			p->worker_count = i;
+			break;
+		}
+	}
+
+	debug_log("job system started with %u worker threads", p->worker_count);
+}
+
+// finishes every queued job, then joins the workers. the pool can be started
+// again afterwards.
+void lite_engine_job_stop(void) {
+	job_pool_t *p = &internal_job_pool;
+
+	while (lite_engine_job_run_one()) {
+	}
+
+	pthread_mutex_lock(&p->sleep_mutex);
+	__atomic_store_n(&p->running, 0, __ATOMIC_RELEASE);
+	pthread_cond_broadcast(&p->wake);
+	pthread_mutex_unlock(&p->sleep_mutex);
+
+	for (ui32 i = 0; i < p->worker_count; i++) {
+		pthread_join(p->threads[i], NULL);
+	}
+
+	for (ui32 i = 0; i < p->deque_count; i++) {
+		internal_job_deque_free(&p->deques[i]);
+	}
+
+	free(p->deques);
+	free(p->threads);
+	free(p->external);
+	p->deques            = NULL;
+	p->deque_count       = 0;
+	p->threads           = NULL;
+	p->worker_count      = 0;
+	p->external          = NULL;
+	p->external_head     = 0;
+	p->external_count    = 0;
+	p->external_capacity = 0;
+
+	internal_job_deque_index = -1;
+}
+
+ui32 lite_engine_job_get_worker_count(void) {
+	return internal_job_pool.worker_count;
+}
+
+static void internal_job_push_external(job_t job) {
+	job_pool_t *p = &internal_job_pool;
+
+	pthread_mutex_lock(&p->external_mutex);
+
+	if (p->external_count >= p->external_capacity) {
+		ui32   capacity = p->external_capacity * 2 + 64;
+		job_t *queue    = malloc(sizeof(*queue) * capacity);
+		for (ui32 i = 0; i < p->external_count; i++) {
+			queue[i] = p->external[(p->external_head + i) % p->external_capacity];
+		}
+		free(p->external);
+		p->external          = queue;
+		p->external_capacity = capacity;
+		p->external_head     = 0;
+	}
+
+	p->external[(p->external_head + p->external_count) % p->external_capacity] = job;
+	__atomic_store_n(&p->external_count, p->external_count + 1, __ATOMIC_RELAXED);
+
+	pthread_mutex_unlock(&p->external_mutex);
+}
+
+// queues 'function(data)'. when 'counter' is not NULL it is incremented now
+// and decremented once the job ran, see lite_engine_job_wait. safe to call
+// from any thread, including from inside a job.
+void lite_engine_job_submit_counted(lite_engine_job_function_t function, void *data,
+		lite_engine_job_counter_t *counter) {
+	job_pool_t *p = &internal_job_pool;
+
+	if (counter != NULL) {
+		__atomic_add_fetch(&counter->value, 1, __ATOMIC_RELAXED);
+	}
+
+	job_t job = {
+		.function = function,
+		.data     = data,
+		.counter  = counter,
+	};
+
+	__atomic_add_fetch(&p->pending, 1, __ATOMIC_SEQ_CST);
+
+	if (p->worker_count == 0) {
+		internal_job_execute(job);
+		return;
+	}
+
+	if (internal_job_deque_index >= 0) {
+		internal_job_deque_push(&p->deques[internal_job_deque_index], job);
+	} else {
+		internal_job_push_external(job);
+	}
+
+	if (__atomic_load_n(&p->sleepers, __ATOMIC_SEQ_CST) > 0) {
+		pthread_mutex_lock(&p->sleep_mutex);
+		pthread_cond_signal(&p->wake);
+		pthread_mutex_unlock(&p->sleep_mutex);
+	}
+}
+
+void lite_engine_job_submit(lite_engine_job_function_t function, void *data) {
+	lite_engine_job_submit_counted(function, data, NULL);
+}
+
+// returns once every job submitted with 'counter' has run. the calling thread
+// keeps executing queued jobs, any of them, while it waits.
+void lite_engine_job_wait(lite_engine_job_counter_t *counter) {
+	while (__atomic_load_n(&counter->value, __ATOMIC_ACQUIRE) != 0) {
+		if (!lite_engine_job_run_one()) {
+			sched_yield();
+		}
+	}
+}
+
+// shared by the caller and the helper jobs of one lite_engine_job_parallel_for.
+// the caller waits on the helpers' counter, so it can live on its stack.
+typedef struct {
+	lite_engine_job_range_function_t function;
+	void                            *data;
+	ui32                             count;
+	ui32                             batch_size;
+	ui32                             batch_count;
+	ui32                             next_batch; // atomic
+} parallel_for_t;
+
+// helpers claim batches until none are left, so a helper that starts late
+// does not hold the others up
+static void internal_job_parallel_for_run(void *data) {
+	parallel_for_t *p = data;
+	for (;;) {
+		ui32 batch = __atomic_fetch_add(&p->next_batch, 1, __ATOMIC_RELAXED);
+		if (batch >= p->batch_count) {
+			break;
+		}
+		ui32 begin = batch * p->batch_size;
+		ui32 end   = begin + p->batch_size < p->count ? begin + p->batch_size : p->count;
+		p->function(p->data, begin, end);
+	}
+}
+
+// calls function(data, begin, end) over [0, count) in batches of
+// 'batch_size', spread over the workers and the calling thread. returns once
+// every batch has run. a 'batch_size' of 0 picks one that gives each thread
+// about four batches, enough to even out uneven work.
+void lite_engine_job_parallel_for(ui32 count, ui32 batch_size,
+		lite_engine_job_range_function_t function, void *data) {
+	if (count == 0) {
+		return;
+	}
+
+	ui32 threads = internal_job_pool.worker_count + 1;
+	if (batch_size == 0) {
+		batch_size = count / (threads * 4);
+		if (batch_size == 0) {
+			batch_size = 1;
+		}
+	}
+
+	ui32 batch_count = (count + batch_size - 1) / batch_size;
+	ui32 helpers     = internal_job_pool.worker_count < batch_count - 1 ?
+		internal_job_pool.worker_count : batch_count - 1;
+
+	if (helpers == 0) {
+		function(data, 0, count);
+		return;
+	}
+
+	parallel_for_t p = {
+		.function    = function,
+		.data        = data,
+		.count       = count,
+		.batch_size  = batch_size,
+		.batch_count = batch_count,
+	};
+
+	lite_engine_job_counter_t counter = {0};
+	for (ui32 i = 0; i < helpers; i++) {
+		lite_engine_job_submit_counted(internal_job_parallel_for_run, &p, &counter);
+	}
+
+	internal_job_parallel_for_run(&p);
+	lite_engine_job_wait(&counter);
+}
@@ -0,0 +1,357 @@
+#include "lite_engine.h"
+
+#include <pthread.h>
+#include <time.h>
+
+// systems declare which components they read and write. from that a
+// dependency graph is built: a system runs after every earlier registered
+// system it conflicts with (one writes what the other reads or writes), and
+// after every system it was explicitly made to depend on, for data that does
+// not live in components. systems without a path between them run in
+// parallel on the job workers. systems flagged LITE_ENGINE_SYSTEM_MAIN_THREAD,
+// like GL submission, only ever run on the thread calling
+// lite_engine_system_run and keep their registration order.
+//
+// the engine's own frame stages are systems as well, so this is the frame
+// task graph. it is cached and only rebuilt after a system or dependency is
+// added. every run records when each system started and how long it took.
+//
+// systems flagged LITE_ENGINE_SYSTEM_FIXED_STEP form a second graph that
+// lite_engine_system_run_fixed_step runs once per simulation tick, zero or
+// more times per frame. there are no edges between the two graphs, the
+// fixed steps of an update all finish before its frame systems start.
+
+typedef struct {
+	const char                    *name;
+	lite_engine_system_function_t  function;
+	void                          *data;
+	ui64                           read;
+	ui64                           write;
+	ui8                            flags;
+
+	ui32                          *after; // explicit dependencies
+	ui32                           after_count;
+	ui32                           after_capacity;
+
+	ui32                          *successors;
+	ui32                           successor_count;
+	ui32                           successor_capacity;
+	ui32                           dependency_count;
+	ui32                           remaining; // dependencies left this run, atomic
+
+	double                         start;
+	double                         end;
+	ui32                           gated_by;
+	ui8                            critical;
+} system_t;
+
+typedef struct {
+	system_t        *systems;
+	ui32             count;
+	ui32             capacity;
+	ui8              graph_dirty;
+
+	// main thread systems that became ready, each is queued at most once per run
+	ui32            *main_queue;
+	ui32             main_head;
+	ui32             main_tail;
+	ui32             left;
+
+	double           run_start;
+	double           run_time;
+
+	pthread_mutex_t  mutex;
+	pthread_cond_t   ready;
+} system_scheduler_t;
+
+static system_scheduler_t internal_scheduler = {
+	.mutex = PTHREAD_MUTEX_INITIALIZER,
+	.ready = PTHREAD_COND_INITIALIZER,
+};
+
+static double internal_system_time(void) {
+	struct timespec spec;
+	clock_gettime(CLOCK_MONOTONIC, &spec);
+	return spec.tv_sec + spec.tv_nsec * 1e-9;
+}
+
+// registers a system and returns its id. 'read' and 'write' are masks built
+// with LITE_ENGINE_COMPONENT_MASK. systems may not be registered while
+// lite_engine_system_run is running.
+ui32 lite_engine_system_register(const char *name, lite_engine_system_function_t function,
+		void *data, ui64 read, ui64 write, ui8 flags) {
+	system_scheduler_t *s = &internal_scheduler;
+
+	if (s->count >= s->capacity) {
+		s->capacity   = s->capacity * 2 + 16;
+		s->systems    = realloc(s->systems,    sizeof(*s->systems)    * s->capacity);
+		s->main_queue = realloc(s->main_queue, sizeof(*s->main_queue) * s->capacity);
+	}
+
+	s->systems[s->count] = (system_t) {
+		.name     = name,
+		.function = function,
+		.data     = data,
+		.read     = read,
+		.write    = write,
+		.flags    = flags,
+		.gated_by = LITE_ENGINE_SYSTEM_NONE,
+	};
+	s->graph_dirty = 1;
+
+	return s->count++;
+}
+
+// makes 'system' run after 'after' every frame, whether or not their
+// components overlap. 'after' has to be registered first, which keeps the
+// graph free of cycles.
+void lite_engine_system_depend(ui32 system, ui32 after) {
+	system_scheduler_t *s = &internal_scheduler;
+
+	if (system >= s->count || after >= system) {
+		debug_error("system %u can not depend on system %u, dependencies must be registered first",
+				system, after);
+		return;
+	}
+
+	system_t *dependent = &s->systems[system];
+	if (dependent->after_count >= dependent->after_capacity) {
+		dependent->after_capacity = dependent->after_capacity * 2 + 4;
+		dependent->after = realloc(dependent->after, sizeof(*dependent->after) * dependent->after_capacity);
+	}
+	dependent->after[dependent->after_count++] = after;
+	s->graph_dirty = 1;
+}
+
+static ui8 internal_system_in_phase(const system_t *system, ui8 phase) {
+	return (system->flags & LITE_ENGINE_SYSTEM_FIXED_STEP) == phase;
+}
+
+static ui8 internal_system_conflicts(const system_t *a, const system_t *b) {
+	if ((a->flags & LITE_ENGINE_SYSTEM_MAIN_THREAD) && (b->flags & LITE_ENGINE_SYSTEM_MAIN_THREAD)) {
+		return 1;
+	}
+	return (a->write & (b->read | b->write)) || (b->write & a->read);
+}
+
+static ui8 internal_system_depends(const system_t *system, ui32 before) {
+	for (ui32 i = 0; i < system->after_count; i++) {
+		if (system->after[i] == before) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static void internal_system_build_graph(void) {
+	system_scheduler_t *s = &internal_scheduler;
+
+	for (ui32 i = 0; i < s->count; i++) {
+		s->systems[i].successor_count  = 0;
+		s->systems[i].dependency_count = 0;
+	}
+
+	for (ui32 j = 0; j < s->count; j++) {
+		for (ui32 i = 0; i < j; i++) {
+			system_t *before = &s->systems[i];
+			if ((before->flags & LITE_ENGINE_SYSTEM_FIXED_STEP) !=
+					(s->systems[j].flags & LITE_ENGINE_SYSTEM_FIXED_STEP)) {
+				continue;
+			}
+			if (!internal_system_conflicts(before, &s->systems[j]) &&
+					!internal_system_depends(&s->systems[j], i)) {
+				continue;
+			}
+			if (before->successor_count >= before->successor_capacity) {
+				before->successor_capacity = before->successor_capacity * 2 + 4;
+				before->successors = realloc(before->successors,
+						sizeof(*before->successors) * before->successor_capacity);
+			}
+			before->successors[before->successor_count++] = j;
+			s->systems[j].dependency_count++;
+		}
+	}
+
+	s->graph_dirty = 0;
+}
+
+static void internal_system_job(void *data);
+
+static void internal_system_dispatch(ui32 index) {
+	system_scheduler_t *s = &internal_scheduler;
+
+	if (s->systems[index].flags & LITE_ENGINE_SYSTEM_MAIN_THREAD) {
+		pthread_mutex_lock(&s->mutex);
+		s->main_queue[s->main_tail++] = index;
+		pthread_cond_signal(&s->ready);
+		pthread_mutex_unlock(&s->mutex);
+	} else {
+		lite_engine_job_submit(internal_system_job, &s->systems[index]);
+	}
+}
+
+static void internal_system_execute(system_t *system) {
+	system_scheduler_t *s     = &internal_scheduler;
+	ui32                index = (ui32)(system - s->systems);
+
+	system->start = internal_system_time() - s->run_start;
+	system->function(system->data);
+	system->end   = internal_system_time() - s->run_start;
+
+	for (ui32 i = 0; i < system->successor_count; i++) {
+		ui32 successor = system->successors[i];
+		if (__atomic_sub_fetch(&s->systems[successor].remaining, 1, __ATOMIC_ACQ_REL) == 0) {
+			// the last dependency to finish is the one that held the successor up
+			s->systems[successor].gated_by = index;
+			internal_system_dispatch(successor);
+		}
+	}
+
+	pthread_mutex_lock(&s->mutex);
+	if (--s->left == 0) {
+		pthread_cond_signal(&s->ready);
+	}
+	pthread_mutex_unlock(&s->mutex);
+}
+
+static void internal_system_job(void *data) {
+	internal_system_execute(data);
+}
+
+// walks back from the system of 'phase' that finished last through whatever
+// held each one up
+static void internal_system_mark_critical_path(ui8 phase) {
+	system_scheduler_t *s    = &internal_scheduler;
+	ui32                last = LITE_ENGINE_SYSTEM_NONE;
+
+	for (ui32 i = 0; i < s->count; i++) {
+		if (!internal_system_in_phase(&s->systems[i], phase)) {
+			continue;
+		}
+		s->systems[i].critical = 0;
+		if (last == LITE_ENGINE_SYSTEM_NONE || s->systems[i].end > s->systems[last].end) {
+			last = i;
+		}
+	}
+
+	for (ui32 i = last; i != LITE_ENGINE_SYSTEM_NONE; i = s->systems[i].gated_by) {
+		s->systems[i].critical = 1;
+	}
+}
+
+// runs every system of 'phase' once and returns when all of them finished.
+// main thread systems are executed here, everything else on the job workers.
+static void internal_system_run(ui8 phase) {
+	system_scheduler_t *s = &internal_scheduler;
+
+	if (s->graph_dirty) {
+		internal_system_build_graph();
+	}
+
+	s->left      = 0;
+	s->main_head = 0;
+	s->main_tail = 0;
+	s->run_start = internal_system_time();
+	for (ui32 i = 0; i < s->count; i++) {
+		if (!internal_system_in_phase(&s->systems[i], phase)) {
+			continue;
+		}
+		s->systems[i].remaining = s->systems[i].dependency_count;
+		s->systems[i].gated_by  = LITE_ENGINE_SYSTEM_NONE;
+		s->left++;
+	}
+
+	if (s->left == 0) {
+		return;
+	}
+
+	for (ui32 i = 0; i < s->count; i++) {
+		if (internal_system_in_phase(&s->systems[i], phase) && s->systems[i].dependency_count == 0) {
+			internal_system_dispatch(i);
+		}
+	}
+
+	// between main thread systems this thread helps with the worker systems
+	// and only sleeps when there is nothing it could run
+	pthread_mutex_lock(&s->mutex);
+	while (s->left > 0) {
+		if (s->main_head == s->main_tail) {
+			pthread_mutex_unlock(&s->mutex);
+			ui8 ran = lite_engine_job_run_one();
+			pthread_mutex_lock(&s->mutex);
+			if (!ran && s->main_head == s->main_tail && s->left > 0) {
+				pthread_cond_wait(&s->ready, &s->mutex);
+			}
+			continue;
+		}
+		ui32 index = s->main_queue[s->main_head++];
+		pthread_mutex_unlock(&s->mutex);
+		internal_system_execute(&s->systems[index]);
+		pthread_mutex_lock(&s->mutex);
+	}
+	pthread_mutex_unlock(&s->mutex);
+
+	internal_system_mark_critical_path(phase);
+}
+
+// runs every system not flagged LITE_ENGINE_SYSTEM_FIXED_STEP once
+void lite_engine_system_run(void) {
+	internal_system_run(0);
+	internal_scheduler.run_time = internal_system_time() - internal_scheduler.run_start;
+}
+
+// runs every system flagged LITE_ENGINE_SYSTEM_FIXED_STEP once, i.e. one
+// simulation tick
+void lite_engine_system_run_fixed_step(void) {
+	internal_system_run(LITE_ENGINE_SYSTEM_FIXED_STEP);
+}
+
+ui32 lite_engine_system_get_count(void) {
+	return internal_scheduler.count;
+}
+
+lite_engine_system_timing_t lite_engine_system_get_timing(ui32 system) {
+	const system_t *sys = &internal_scheduler.systems[system];
+	return (lite_engine_system_timing_t) {
+		.name     = sys->name,
+		.start    = sys->start,
+		.duration = sys->end - sys->start,
+		.gated_by = sys->gated_by,
+		.critical = sys->critical,
+	};
+}
+
+// wall time of the last lite_engine_system_run, in seconds. fixed steps are
+// not included.
+double lite_engine_system_get_frame_time(void) {
+	return internal_scheduler.run_time;
+}
+
+// logs the timings of the last run, the critical path marked with a '*'
+void lite_engine_system_log_timings(void) {
+	system_scheduler_t *s = &internal_scheduler;
+
+	debug_log("systems ran in %.3f ms", s->run_time * 1e3);
+	for (ui32 i = 0; i < s->count; i++) {
+		lite_engine_system_timing_t timing = lite_engine_system_get_timing(i);
+		debug_log("%c %-20s start %8.3f ms  took %8.3f ms",
+				timing.critical ? '*' : ' ', timing.name,
+				timing.start * 1e3, timing.duration * 1e3);
+	}
+}
+
+void lite_engine_system_free_all(void) {
+	system_scheduler_t *s = &internal_scheduler;
+
+	for (ui32 i = 0; i < s->count; i++) {
+		free(s->systems[i].after);
+		free(s->systems[i].successors);
+	}
+	free(s->systems);
+	free(s->main_queue);
+	s->systems     = NULL;
+	s->main_queue  = NULL;
+	s->count       = 0;
+	s->capacity    = 0;
+	s->graph_dirty = 0;
+}